@@ -0,0 +1,214 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace ttl
+{
+namespace internal
+{
+constexpr size_t default_alignment = 64;
+
+inline void *aligned_alloc_bytes(size_t size, size_t alignment)
+{
+    void *p = nullptr;
+    if (posix_memalign(&p, alignment, size ? size : alignment) != 0) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+inline void aligned_free_bytes(void *p) { std::free(p); }
+
+/*! An allocator that returns memory aligned to `alignment` bytes, which
+    defaults to a cache line, so SIMD kernels can assume alignment.
+*/
+template <typename R, size_t alignment = default_alignment>
+struct aligned_allocator {
+    using value_type = R;
+
+    template <typename S> struct rebind {
+        using other = aligned_allocator<S, alignment>;
+    };
+
+    aligned_allocator() = default;
+
+    template <typename S>
+    aligned_allocator(const aligned_allocator<S, alignment> &)
+    {
+    }
+
+    R *allocate(size_t n)
+    {
+        return static_cast<R *>(aligned_alloc_bytes(n * sizeof(R), alignment));
+    }
+
+    void deallocate(R *p, size_t /* n */) { aligned_free_bytes(p); }
+};
+
+template <typename R, typename S, size_t a>
+bool operator==(const aligned_allocator<R, a> &,
+                const aligned_allocator<S, a> &)
+{
+    return true;
+}
+
+template <typename R, typename S, size_t a>
+bool operator!=(const aligned_allocator<R, a> &,
+                const aligned_allocator<S, a> &)
+{
+    return false;
+}
+
+/*! A thread-safe cache of aligned blocks, keyed by size.
+    Blocks released to the pool are handed out again to the next request of
+    the same size, so tensors of the same shape that are created for every
+    frame reuse memory instead of hitting the heap.
+*/
+class tensor_pool
+{
+  public:
+    explicit tensor_pool(size_t alignment = default_alignment)
+        : alignment(alignment), hits_(0), misses_(0)
+    {
+    }
+
+    ~tensor_pool()
+    {
+        for (auto &it : free_blocks) {
+            for (void *p : it.second) { aligned_free_bytes(p); }
+        }
+    }
+
+    tensor_pool(const tensor_pool &) = delete;
+    tensor_pool &operator=(const tensor_pool &) = delete;
+
+    void *acquire(size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> _(mu);
+            auto &blocks = free_blocks[size];
+            if (!blocks.empty()) {
+                void *p = blocks.back();
+                blocks.pop_back();
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                return p;
+            }
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return aligned_alloc_bytes(size, alignment);
+    }
+
+    void release(void *p, size_t size)
+    {
+        std::lock_guard<std::mutex> _(mu);
+        free_blocks[size].push_back(p);
+    }
+
+    // number of requests served from / not served from the cache
+    size_t hits() const { return hits_.load(std::memory_order_relaxed); }
+
+    size_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+  private:
+    const size_t alignment;
+
+    std::mutex mu;
+    std::unordered_map<size_t, std::vector<void *>> free_blocks;
+    std::atomic<size_t> hits_;
+    std::atomic<size_t> misses_;
+};
+
+// Never destroyed, so that pooled tensors with static storage duration can
+// still release their memory to it at exit.
+inline tensor_pool &default_tensor_pool()
+{
+    static tensor_pool *pool = new tensor_pool;
+    return *pool;
+}
+
+//! An allocator that takes its memory from a tensor_pool.
+template <typename R> struct pooled_allocator {
+    using value_type = R;
+
+    template <typename S> struct rebind {
+        using other = pooled_allocator<S>;
+    };
+
+    tensor_pool *pool;
+
+    pooled_allocator() : pool(&default_tensor_pool()) {}
+
+    explicit pooled_allocator(tensor_pool &pool) : pool(&pool) {}
+
+    template <typename S>
+    pooled_allocator(const pooled_allocator<S> &a) : pool(a.pool)
+    {
+    }
+
+    R *allocate(size_t n)
+    {
+        return static_cast<R *>(pool->acquire(n * sizeof(R)));
+    }
+
+    void deallocate(R *p, size_t n) { pool->release(p, n * sizeof(R)); }
+};
+
+template <typename R, typename S>
+bool operator==(const pooled_allocator<R> &a, const pooled_allocator<S> &b)
+{
+    return a.pool == b.pool;
+}
+
+template <typename R, typename S>
+bool operator!=(const pooled_allocator<R> &a, const pooled_allocator<S> &b)
+{
+    return a.pool != b.pool;
+}
+
+//! Destroys and deallocates the n elements owned by a basic_tensor.
+template <typename R, typename allocator_t> class tensor_deleter
+{
+  public:
+    tensor_deleter() : n(0) {}
+
+    tensor_deleter(const allocator_t &allocator, size_t n)
+        : allocator(allocator), n(n)
+    {
+    }
+
+    void operator()(R *p)
+    {
+        destroy(p, n);
+        allocator.deallocate(p, n);
+    }
+
+    const allocator_t &get_allocator() const { return allocator; }
+
+    static R *create(allocator_t &allocator, size_t n)
+    {
+        R *p = allocator.allocate(n);
+        if (!std::is_trivially_default_constructible<R>::value) {
+            for (size_t i = 0; i < n; ++i) { new (p + i) R(); }
+        }
+        return p;
+    }
+
+  private:
+    allocator_t allocator;
+    size_t n;
+
+    static void destroy(R *p, size_t n)
+    {
+        if (!std::is_trivially_destructible<R>::value) {
+            for (size_t i = 0; i < n; ++i) { p[i].~R(); }
+        }
+    }
+};
+}  // namespace internal
+}  // namespace ttl
@@ -1,54 +1,75 @@
 #pragma once
 #include <cstddef>
-#include <cstdint>
-#include <memory>
+#include <new>
 
 #include <cuda_runtime.h>
 
-#include <bits/std_shape.hpp>
+#include <bits/std_device_tensor.hpp>
 
-template <typename T> struct cuda_mem_allocator {
-    T *operator()(int count)
-    {
-        T *deviceMem;
-        cudaMalloc<T>(&deviceMem, count);
-        return deviceMem;
-    }
-};
+namespace ttl
+{
+namespace internal
+{
+class cuda_stream
+{
+  public:
+    cuda_stream() { cudaStreamCreate(&stream); }
+
+    ~cuda_stream() { cudaStreamDestroy(stream); }
+
+    cuda_stream(const cuda_stream &) = delete;
+    cuda_stream &operator=(const cuda_stream &) = delete;
+
+    cudaStream_t get() const { return stream; }
+
+    void sync() { cudaStreamSynchronize(stream); }
 
-struct cuda_mem_deleter {
-    void operator()(void *ptr) { cudaFree(ptr); }
+  private:
+    cudaStream_t stream;
 };
 
-template <typename R, rank_t r> class basic_cuda_tensor
-{
-  public:
-    template <typename... D>
-    explicit basic_cuda_tensor(D... d)
-        : shape_(d...), count(shape_.size()),
-          data_(cuda_mem_allocator<R>()(count))
+// Async copies only overlap with compute if the host buffer is pinned
+// (cudaMallocHost), otherwise cudaMemcpyAsync is staged synchronously.
+struct cuda_device {
+    using stream_t = cuda_stream;
+
+    static void *allocate(size_t size)
     {
-        TRACE(__func__);
+        void *p = nullptr;
+        if (cudaMalloc(&p, size) != cudaSuccess) { throw std::bad_alloc(); }
+        return p;
     }
 
-    R *data() { return data_.get(); }
+    static void free(void *p) { cudaFree(p); }
 
-    void fromHost(void *buffer)
+    static void copy_from_host(void *dst, const void *src, size_t size)
     {
-        cudaMemcpy(data_.get(), buffer, count * sizeof(R),
-                   cudaMemcpyHostToDevice);
+        cudaMemcpy(dst, src, size, cudaMemcpyHostToDevice);
     }
 
-    void toHost(void *buffer)
+    static void copy_to_host(void *dst, const void *src, size_t size)
     {
-        cudaMemcpy(buffer, data_.get(), count * sizeof(R),
-                   cudaMemcpyDeviceToHost);
+        cudaMemcpy(dst, src, size, cudaMemcpyDeviceToHost);
     }
 
-  private:
-    const shape<r> shape_;
-    const size_t count;
-    const std::unique_ptr<R, cuda_mem_deleter> data_;
+    static void copy_from_host(void *dst, const void *src, size_t size,
+                               stream_t &stream)
+    {
+        cudaMemcpyAsync(dst, src, size, cudaMemcpyHostToDevice, stream.get());
+    }
+
+    static void copy_to_host(void *dst, const void *src, size_t size,
+                             stream_t &stream)
+    {
+        cudaMemcpyAsync(dst, src, size, cudaMemcpyDeviceToHost, stream.get());
+    }
 };
+}  // namespace internal
+}  // namespace ttl
+
+template <typename R, ttl::internal::rank_t r>
+using basic_cuda_tensor =
+    ttl::internal::device_tensor<R, r, ttl::internal::cuda_device>;
 
-template <typename R, rank_t r> using cuda_tensor = basic_cuda_tensor<R, r>;
+template <typename R, ttl::internal::rank_t r>
+using cuda_tensor = basic_cuda_tensor<R, r>;
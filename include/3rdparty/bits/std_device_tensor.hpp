@@ -0,0 +1,118 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+
+#include <bits/std_shape.hpp>
+#include <bits/std_tensor.hpp>
+
+namespace ttl
+{
+namespace internal
+{
+template <typename device_t> struct device_deleter {
+    void operator()(void *p) { device_t::free(p); }
+};
+
+/*! A tensor that lives in the memory of device_t.
+
+    device_t provides static allocate/free (in bytes), and synchronous and
+    stream-ordered copy_from_host/copy_to_host. The asynchronous copies
+    return immediately, the host buffer must stay alive and untouched until
+    the stream is synced.
+*/
+template <typename R, rank_t r, typename device_t,
+          typename shape_t = basic_shape<r>>
+class device_tensor
+{
+  public:
+    using stream_t = typename device_t::stream_t;
+
+    static constexpr rank_t rank = r;
+
+    template <typename... D>
+    explicit device_tensor(D... d) : device_tensor(shape_t(d...))
+    {
+    }
+
+    explicit device_tensor(const shape_t &shape)
+        : shape_(shape),
+          data_(static_cast<R *>(device_t::allocate(bytes(shape))))
+    {
+    }
+
+    device_tensor(device_tensor &&) = default;
+
+    device_tensor &operator=(device_tensor &&) = default;
+
+    R *data() { return data_.get(); }
+
+    const R *data() const { return data_.get(); }
+
+    shape_t shape() const { return shape_; }
+
+    void from_host(const void *buffer)
+    {
+        device_t::copy_from_host(data_.get(), buffer, bytes(shape_));
+    }
+
+    void to_host(void *buffer) const
+    {
+        device_t::copy_to_host(buffer, data_.get(), bytes(shape_));
+    }
+
+    void from_host(const void *buffer, stream_t &stream)
+    {
+        device_t::copy_from_host(data_.get(), buffer, bytes(shape_), stream);
+    }
+
+    void to_host(void *buffer, stream_t &stream) const
+    {
+        device_t::copy_to_host(buffer, data_.get(), bytes(shape_), stream);
+    }
+
+    void from_host(const basic_tensor_view<R, r, shape_t> &t)
+    {
+        check_shape(t.shape());
+        from_host(t.data());
+    }
+
+    void to_host(const basic_tensor_ref<R, r, shape_t> &t) const
+    {
+        check_shape(t.shape());
+        to_host((R *)/* FIXME */ t.data());
+    }
+
+    void from_host(const basic_tensor_view<R, r, shape_t> &t,
+                   stream_t &stream)
+    {
+        check_shape(t.shape());
+        from_host(t.data(), stream);
+    }
+
+    void to_host(const basic_tensor_ref<R, r, shape_t> &t,
+                 stream_t &stream) const
+    {
+        check_shape(t.shape());
+        to_host((R *)/* FIXME */ t.data(), stream);
+    }
+
+    void fromHost(void *buffer) { from_host(buffer); }  // FIXME: deprecate
+
+    void toHost(void *buffer) { to_host(buffer); }  // FIXME: deprecate
+
+  private:
+    shape_t shape_;
+    std::unique_ptr<R, device_deleter<device_t>> data_;
+
+    static size_t bytes(const shape_t &shape) { return shape.size() * sizeof(R); }
+
+    void check_shape(const shape_t &shape) const
+    {
+        if (shape.dims != shape_.dims) {
+            throw std::invalid_argument("device_tensor: shape mismatch");
+        }
+    }
+};
+}  // namespace internal
+}  // namespace ttl
@@ -0,0 +1,180 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <bits/std_tensor.hpp>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STD_HALF_HAS_F16C 1
+#include <immintrin.h>
+#else
+#define STD_HALF_HAS_F16C 0
+#endif
+
+namespace ttl
+{
+namespace internal
+{
+/*! IEEE 754 binary16, a storage-only type.
+    Convert to float for arithmetic, use half_to_float/float_to_half for bulk
+    conversion, which use F16C when the CPU supports it.
+*/
+struct half {
+    uint16_t bits;
+
+    half() = default;
+
+    explicit half(float x) : bits(from_float(x)) {}
+
+    explicit operator float() const { return to_float(bits); }
+
+    static uint16_t from_float(float x)
+    {
+        uint32_t f;
+        std::memcpy(&f, &x, sizeof(f));
+        const uint32_t sign = (f >> 16) & 0x8000;
+        const uint32_t abs = f & 0x7fffffff;
+
+        if (abs >= 0x7f800000) {  // inf or nan
+            return sign | 0x7c00 |
+                   (abs > 0x7f800000 ? 0x200 | ((abs >> 13) & 0x3ff) : 0);
+        }
+        if (abs >= 0x477ff000) { return sign | 0x7c00; }  // overflow
+        if (abs < 0x38800000) {  // subnormal or zero
+            if (abs < 0x33000000) { return sign; }
+            const uint32_t shift = 126 - (abs >> 23);
+            const uint32_t m = (abs & 0x7fffff) | 0x800000;
+            uint32_t h = m >> shift;
+            const uint32_t rest = m & ((1u << shift) - 1);
+            const uint32_t halfway = 1u << (shift - 1);
+            if (rest > halfway || (rest == halfway && (h & 1))) { ++h; }
+            return sign | h;
+        }
+        // normal, round to nearest even
+        uint32_t h = ((abs - 0x38000000) >> 13);
+        const uint32_t rest = abs & 0x1fff;
+        if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) { ++h; }
+        return sign | h;
+    }
+
+    static float to_float(uint16_t h)
+    {
+        const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+        const uint32_t e = (h >> 10) & 0x1f;
+        uint32_t m = h & 0x3ff;
+        uint32_t f;
+        if (e == 0x1f) {  // inf or nan, nans are quieted like F16C does
+            f = sign | 0x7f800000 | (m << 13) | (m ? 0x400000 : 0);
+        } else if (e != 0) {
+            f = sign | ((e + 112) << 23) | (m << 13);
+        } else if (m == 0) {
+            f = sign;
+        } else {  // subnormal
+            uint32_t e32 = 113;
+            while ((m & 0x400) == 0) {
+                m <<= 1;
+                --e32;
+            }
+            f = sign | (e32 << 23) | ((m & 0x3ff) << 13);
+        }
+        float x;
+        std::memcpy(&x, &f, sizeof(x));
+        return x;
+    }
+};
+
+static_assert(sizeof(half) == 2, "invalid size of half");
+
+inline void half_to_float_scalar(const half *src, float *dst, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) { dst[i] = half::to_float(src[i].bits); }
+}
+
+inline void float_to_half_scalar(const float *src, half *dst, size_t n)
+{
+    for (size_t i = 0; i < n; ++i) { dst[i].bits = half::from_float(src[i]); }
+}
+
+#if STD_HALF_HAS_F16C
+
+__attribute__((target("avx,f16c"))) inline void
+half_to_float_f16c(const half *src, float *dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i h =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(h));
+    }
+    half_to_float_scalar(src + i, dst + i, n - i);
+}
+
+__attribute__((target("avx,f16c"))) inline void
+float_to_half_f16c(const float *src, half *dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + i),
+                                          _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), h);
+    }
+    float_to_half_scalar(src + i, dst + i, n - i);
+}
+
+inline bool has_f16c()
+{
+    static const bool supported = []() {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx") != 0 &&
+               __builtin_cpu_supports("f16c") != 0;
+    }();
+    return supported;
+}
+
+#endif  // STD_HALF_HAS_F16C
+
+inline void half_to_float(const half *src, float *dst, size_t n)
+{
+#if STD_HALF_HAS_F16C
+    if (has_f16c()) {
+        half_to_float_f16c(src, dst, n);
+        return;
+    }
+#endif
+    half_to_float_scalar(src, dst, n);
+}
+
+inline void float_to_half(const float *src, half *dst, size_t n)
+{
+#if STD_HALF_HAS_F16C
+    if (has_f16c()) {
+        float_to_half_f16c(src, dst, n);
+        return;
+    }
+#endif
+    float_to_half_scalar(src, dst, n);
+}
+
+template <rank_t r>
+void cast(const basic_tensor_view<half, r> &x,
+          const basic_tensor_ref<float, r> &y)
+{
+    if (x.shape().size() != y.shape().size()) {
+        throw std::invalid_argument("cast: size mismatch");
+    }
+    half_to_float(x.data(), (float *)/* FIXME */ y.data(), x.shape().size());
+}
+
+template <rank_t r>
+void cast(const basic_tensor_view<float, r> &x,
+          const basic_tensor_ref<half, r> &y)
+{
+    if (x.shape().size() != y.shape().size()) {
+        throw std::invalid_argument("cast: size mismatch");
+    }
+    float_to_half(x.data(), (half *)/* FIXME */ y.data(), x.shape().size());
+}
+}  // namespace internal
+}  // namespace ttl
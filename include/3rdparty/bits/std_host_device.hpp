@@ -0,0 +1,120 @@
+#pragma once
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <bits/std_allocator.hpp>
+
+namespace ttl
+{
+namespace internal
+{
+/*! An in-order queue of work run by a worker thread.
+    It plays the role of a CUDA stream for host_device, tasks submitted to
+    the same stream run one after another in submission order.
+*/
+class host_stream
+{
+  public:
+    host_stream() : pending(0), stopped(false), worker([this] { run(); }) {}
+
+    ~host_stream()
+    {
+        sync();
+        {
+            std::lock_guard<std::mutex> _(mu);
+            stopped = true;
+        }
+        not_empty.notify_one();
+        worker.join();
+    }
+
+    host_stream(const host_stream &) = delete;
+    host_stream &operator=(const host_stream &) = delete;
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> _(mu);
+            tasks.push_back(std::move(task));
+            ++pending;
+        }
+        not_empty.notify_one();
+    }
+
+    //! Blocks until all submitted tasks have finished.
+    void sync()
+    {
+        std::unique_lock<std::mutex> lk(mu);
+        done.wait(lk, [this] { return pending == 0; });
+    }
+
+  private:
+    std::mutex mu;
+    std::condition_variable not_empty;
+    std::condition_variable done;
+    std::deque<std::function<void()>> tasks;
+    size_t pending;
+    bool stopped;
+
+    std::thread worker;  // must be the last member
+
+    void run()
+    {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lk(mu);
+                not_empty.wait(lk, [this] { return stopped || !tasks.empty(); });
+                if (tasks.empty()) { return; }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> _(mu);
+                --pending;
+            }
+            done.notify_all();
+        }
+    }
+};
+
+//! The device of device_tensor that lives in host memory.
+struct host_device {
+    using stream_t = host_stream;
+
+    static void *allocate(size_t size)
+    {
+        return aligned_alloc_bytes(size, default_alignment);
+    }
+
+    static void free(void *p) { aligned_free_bytes(p); }
+
+    static void copy_from_host(void *dst, const void *src, size_t size)
+    {
+        std::memcpy(dst, src, size);
+    }
+
+    static void copy_to_host(void *dst, const void *src, size_t size)
+    {
+        std::memcpy(dst, src, size);
+    }
+
+    static void copy_from_host(void *dst, const void *src, size_t size,
+                               stream_t &stream)
+    {
+        stream.submit([=] { std::memcpy(dst, src, size); });
+    }
+
+    static void copy_to_host(void *dst, const void *src, size_t size,
+                             stream_t &stream)
+    {
+        stream.submit([=] { std::memcpy(dst, src, size); });
+    }
+};
+}  // namespace internal
+}  // namespace ttl
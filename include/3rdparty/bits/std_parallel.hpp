@@ -0,0 +1,318 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <bits/std_tensor.hpp>
+
+namespace ttl
+{
+namespace internal
+{
+/*! A work-stealing thread pool.
+    Each worker owns a deque, it takes its own tasks from the back and steals
+    from the front of the others when it runs out. The thread calling
+    parallel_for also runs tasks until its range is done, so nested calls
+    from inside a task don't deadlock.
+*/
+class thread_pool
+{
+  public:
+    explicit thread_pool(size_t n = default_size())
+        : queued(0), stopped(false), next(0)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            queues.emplace_back(new queue_t);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            workers.emplace_back([this, i] { run(i); });
+        }
+    }
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> _(mu);
+            stopped = true;
+        }
+        cv.notify_all();
+        for (auto &w : workers) { w.join(); }
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    //! Calls f(begin, end) on disjoint ranges covering [0, n), each range
+    //! has at most grain elements. Rethrows the first exception thrown by f.
+    template <typename F>
+    void parallel_for(size_t n, size_t grain, const F &f)
+    {
+        grain = std::max<size_t>(grain, 1);
+        const size_t k = (n + grain - 1) / grain;
+        if (k == 0) { return; }
+        if (k == 1 || queues.empty()) {
+            f(0, n);
+            return;
+        }
+
+        struct state_t {
+            std::atomic<size_t> remaining;
+            std::mutex mu;
+            std::exception_ptr error;
+        };
+        auto st = std::make_shared<state_t>();
+        st->remaining = k;
+
+        {
+            // counted before pushing, so workers never see it go below zero
+            std::lock_guard<std::mutex> _(mu);
+            queued += k;
+        }
+        const size_t q0 = next.fetch_add(1) % queues.size();
+        for (size_t j = 0; j < k; ++j) {
+            const size_t begin = j * grain;
+            const size_t end = std::min(n, begin + grain);
+            push((q0 + j) % queues.size(), [st, &f, begin, end] {
+                try {
+                    f(begin, end);
+                } catch (...) {
+                    std::lock_guard<std::mutex> _(st->mu);
+                    if (!st->error) { st->error = std::current_exception(); }
+                }
+                --st->remaining;
+            });
+        }
+        cv.notify_all();
+
+        while (st->remaining > 0) {
+            if (!try_run(self_index())) { std::this_thread::yield(); }
+        }
+        if (st->error) { std::rethrow_exception(st->error); }
+    }
+
+    static size_t default_size()
+    {
+        const size_t n = std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+    }
+
+  private:
+    using task_t = std::function<void()>;
+
+    struct queue_t {
+        std::mutex mu;
+        std::deque<task_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<queue_t>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex mu;
+    std::condition_variable cv;
+    std::atomic<size_t> queued;
+    bool stopped;
+    std::atomic<size_t> next;
+
+    // index of the current thread if it is a worker of this pool
+    size_t self_index() const
+    {
+        return current_pool() == this ? current_index() : queues.size();
+    }
+
+    static const thread_pool *&current_pool()
+    {
+        static thread_local const thread_pool *pool = nullptr;
+        return pool;
+    }
+
+    static size_t &current_index()
+    {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+    void push(size_t i, task_t task)
+    {
+        std::lock_guard<std::mutex> _(queues[i]->mu);
+        queues[i]->tasks.push_back(std::move(task));
+    }
+
+    bool try_run(size_t self)
+    {
+        task_t task;
+        if (self < queues.size()) {
+            auto &q = *queues[self];
+            std::lock_guard<std::mutex> _(q.mu);
+            if (!q.tasks.empty()) {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+        }
+        for (size_t j = 1; !task && j <= queues.size(); ++j) {
+            auto &q = *queues[(self + j) % queues.size()];
+            std::lock_guard<std::mutex> _(q.mu);
+            if (!q.tasks.empty()) {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+        }
+        if (!task) { return false; }
+        --queued;
+        task();
+        return true;
+    }
+
+    void run(size_t i)
+    {
+        current_pool() = this;
+        current_index() = i;
+        for (;;) {
+            if (try_run(i)) { continue; }
+            std::unique_lock<std::mutex> lk(mu);
+            cv.wait(lk, [this] { return stopped || queued > 0; });
+            if (stopped && queued == 0) { return; }
+        }
+    }
+};
+
+inline thread_pool &default_thread_pool()
+{
+    static thread_pool pool;
+    return pool;
+}
+
+//! Calls f(begin, end) over [0, n) in chunks of at most grain.
+template <typename F>
+void parallel_for(size_t n, const F &f, size_t grain = 1)
+{
+    default_thread_pool().parallel_for(n, grain, f);
+}
+
+//! Calls f(t[i]) for each i of the outer dimension.
+template <typename R, rank_t r, typename F>
+void parallel_for(const basic_tensor_ref<R, r> &t, const F &f,
+                  size_t grain = 1)
+{
+    parallel_for(
+        t.shape().dims[0],
+        [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) { f(t[i]); }
+        },
+        grain);
+}
+
+template <typename R, rank_t r, typename F>
+void parallel_for(const basic_tensor_view<R, r> &t, const F &f,
+                  size_t grain = 1)
+{
+    parallel_for(
+        t.shape().dims[0],
+        [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) { f(t[i]); }
+        },
+        grain);
+}
+
+template <typename R, rank_t r, typename allocator_t, typename F>
+void parallel_for(basic_tensor<R, r, basic_shape<r>, allocator_t> &t,
+                  const F &f, size_t grain = 1)
+{
+    parallel_for(ref(t), f, grain);
+}
+
+template <typename R, rank_t r, typename allocator_t, typename F>
+void parallel_for(const basic_tensor<R, r, basic_shape<r>, allocator_t> &t,
+                  const F &f, size_t grain = 1)
+{
+    parallel_for(view(t), f, grain);
+}
+
+//! Calls f(y0, y1, x0, x1) for each tile of a height x width plane.
+template <typename F>
+void parallel_for_tiles(size_t height, size_t width, size_t tile_height,
+                        size_t tile_width, const F &f)
+{
+    tile_height = std::max<size_t>(tile_height, 1);
+    tile_width = std::max<size_t>(tile_width, 1);
+    const size_t rows = (height + tile_height - 1) / tile_height;
+    const size_t cols = (width + tile_width - 1) / tile_width;
+    parallel_for(rows * cols, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            const size_t y0 = k / cols * tile_height;
+            const size_t x0 = k % cols * tile_width;
+            f(y0, std::min(height, y0 + tile_height), x0,
+              std::min(width, x0 + tile_width));
+        }
+    });
+}
+
+//! y[i] = f(x[i]) for each element, in chunks of grain elements.
+template <typename R, typename S, rank_t r, typename F>
+void transform(const basic_tensor_view<R, r> &x,
+               const basic_tensor_ref<S, r> &y, const F &f,
+               size_t grain = 1 << 14)
+{
+    const R *src = x.data();
+    S *dst = (S *)/* FIXME */ y.data();
+    parallel_for(
+        std::min(x.shape().size(), y.shape().size()),
+        [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) { dst[i] = f(src[i]); }
+        },
+        grain);
+}
+
+//! The same for tensors, refs or views x and tensors or refs y.
+template <typename X, typename Y, typename F>
+void transform(const X &x, const Y &y, const F &f, size_t grain = 1 << 14)
+{
+    transform(view(x), ref(y), f, grain);
+}
+
+/*! Reduces map(x[i]) with reduce, starting from init.
+    Each chunk is reduced from init, and the partial results are combined in
+    order, so init must be an identity of reduce and the result doesn't
+    depend on scheduling.
+*/
+template <typename T, typename R, rank_t r, typename M, typename F>
+T map_reduce(const basic_tensor_view<R, r> &x, const T &init, const M &map,
+             const F &reduce, size_t grain = 1 << 14)
+{
+    grain = std::max<size_t>(grain, 1);
+    const size_t n = x.shape().size();
+    const R *src = x.data();
+    std::vector<T> partial((n + grain - 1) / grain, init);
+    parallel_for(
+        n,
+        [&](size_t begin, size_t end) {
+            T acc = init;
+            for (size_t i = begin; i < end; ++i) {
+                acc = reduce(acc, map(src[i]));
+            }
+            partial[begin / grain] = acc;
+        },
+        grain);
+    T acc = init;
+    for (const auto &p : partial) { acc = reduce(acc, p); }
+    return acc;
+}
+
+//! The same for tensors and refs.
+template <typename T, typename X, typename M, typename F>
+T map_reduce(const X &x, const T &init, const M &map, const F &reduce,
+             size_t grain = 1 << 14)
+{
+    return map_reduce(view(x), init, map, reduce, grain);
+}
+}  // namespace internal
+}  // namespace ttl
@@ -3,8 +3,7 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
-#include <functional>
-#include <numeric>
+#include <type_traits>
 #include <utility>
 
 namespace ttl
@@ -36,28 +35,15 @@ template <rank_t r, typename dim_t = uint32_t> class basic_shape
         static_assert(sizeof...(D) == r, "invalid number of dims");
     }
 
-    template <typename... I> dim_t offset(I... args) const
+    template <typename... I> constexpr dim_t offset(I... args) const
     {
         static_assert(sizeof...(I) == r, "invalid number of indexes");
-
-        // TODO: expand the expression
-        const std::array<dim_t, r> offs({static_cast<dim_t>(args)...});
-        dim_t off = 0;
-        for (rank_t i = 0; i < r; ++i) { off = off * dims[i] + offs[i]; }
-        return off;
+        return horner<0>(0, static_cast<dim_t>(args)...);
     }
 
-    dim_t size() const
-    {
-        return std::accumulate(dims.begin(), dims.end(), 1,
-                               std::multiplies<dim_t>());
-    }
+    constexpr dim_t size() const { return product<0>(); }
 
-    dim_t subspace_size() const
-    {
-        return std::accumulate(dims.begin() + 1, dims.end(), 1,
-                               std::multiplies<dim_t>());
-    }
+    constexpr dim_t subspace_size() const { return product<1>(); }
 
     template <rank_t corank = 1>
     using subshape_t = basic_shape<r - corank, dim_t>;
@@ -71,7 +57,30 @@ template <rank_t r, typename dim_t = uint32_t> class basic_shape
     }
 
     //   private:
-    const std::array<dim_t, r> dims;
+    std::array<dim_t, r> dims;
+
+  private:
+    // off * dims[i] + k_i, expanded at compile time
+    template <rank_t i> constexpr dim_t horner(dim_t off) const { return off; }
+
+    template <rank_t i, typename... I>
+    constexpr dim_t horner(dim_t off, dim_t k, I... ks) const
+    {
+        return horner<i + 1>(off * dims[i] + k, ks...);
+    }
+
+    // dims[i] * ... * dims[r - 1]
+    template <rank_t i>
+    constexpr typename std::enable_if<(i >= r), dim_t>::type product() const
+    {
+        return 1;
+    }
+
+    template <rank_t i>
+    constexpr typename std::enable_if<(i < r), dim_t>::type product() const
+    {
+        return dims[i] * product<i + 1>();
+    }
 };
 }  // namespace internal
 }  // namespace ttl
@@ -0,0 +1,200 @@
+#pragma once
+#include <array>
+
+#include <bits/std_shape.hpp>
+#include <bits/std_tensor.hpp>
+
+namespace ttl
+{
+namespace internal
+{
+
+/*! A shape with a stride (in number of elements) for each dimension.
+    Strides are computed once at construction, so non-contiguous views
+    (slices, transposes, a single channel) can be addressed without copy.
+*/
+template <rank_t r, typename dim_t = uint32_t> class basic_strided_shape
+{
+  public:
+    static constexpr rank_t rank = r;
+
+    constexpr basic_strided_shape(const std::array<dim_t, r> &dims,
+                                  const std::array<dim_t, r> &strides)
+        : dims(dims), strides(strides)
+    {
+    }
+
+    // the row-major strides of a contiguous shape
+    explicit basic_strided_shape(const basic_shape<r, dim_t> &shape)
+        : dims(shape.dims)
+    {
+        dim_t stride = 1;
+        for (rank_t i = r; i > 0; --i) {
+            strides[i - 1] = stride;
+            stride *= dims[i - 1];
+        }
+    }
+
+    template <typename... I> constexpr dim_t offset(I... args) const
+    {
+        static_assert(sizeof...(I) == r, "invalid number of indexes");
+        return dot<0>(static_cast<dim_t>(args)...);
+    }
+
+    dim_t size() const
+    {
+        dim_t n = 1;
+        for (rank_t i = 0; i < r; ++i) { n *= dims[i]; }
+        return n;
+    }
+
+    bool contiguous() const
+    {
+        dim_t stride = 1;
+        for (rank_t i = r; i > 0; --i) {
+            if (dims[i - 1] != 1 && strides[i - 1] != stride) { return false; }
+            stride *= dims[i - 1];
+        }
+        return true;
+    }
+
+    // the shape without the given axis
+    template <rank_t axis> basic_strided_shape<r - 1, dim_t> drop() const
+    {
+        static_assert(axis < r, "invalid axis");
+        std::array<dim_t, r - 1> ds;
+        std::array<dim_t, r - 1> ss;
+        for (rank_t i = 0, j = 0; i < r; ++i) {
+            if (i == axis) { continue; }
+            ds[j] = dims[i];
+            ss[j] = strides[i];
+            ++j;
+        }
+        return basic_strided_shape<r - 1, dim_t>(ds, ss);
+    }
+
+    std::array<dim_t, r> dims;
+    std::array<dim_t, r> strides;
+
+  private:
+    // k_i * strides[i] + ..., expanded at compile time
+    template <rank_t i> constexpr dim_t dot() const { return 0; }
+
+    template <rank_t i, typename... I>
+    constexpr dim_t dot(dim_t k, I... ks) const
+    {
+        return k * strides[i] + dot<i + 1>(ks...);
+    }
+};
+
+template <typename R, rank_t r, typename dim_t = uint32_t>
+class basic_strided_tensor_ref;
+
+template <typename R, typename dim_t>
+class basic_strided_tensor_ref<R, 0, dim_t>
+{
+    R *const data_;
+
+  public:
+    static constexpr rank_t rank = 0;
+
+    explicit basic_strided_tensor_ref(R *data,
+                                      const basic_strided_shape<0, dim_t> &)
+        : data_(data)
+    {
+    }
+
+    R *data() const { return data_; }
+
+    R &at() const { return data_[0]; }
+};
+
+/*! A non-owning reference to a tensor with arbitrary strides.
+    Use basic_strided_tensor_ref<const R, r> for a read-only view.
+*/
+template <typename R, rank_t r, typename dim_t> class basic_strided_tensor_ref
+{
+  public:
+    using shape_t = basic_strided_shape<r, dim_t>;
+    using subspace_t = basic_strided_tensor_ref<R, r - 1, dim_t>;
+
+    static constexpr rank_t rank = r;
+
+    explicit basic_strided_tensor_ref(R *data, const shape_t &shape)
+        : shape_(shape), data_(data)
+    {
+    }
+
+    R *data() const { return data_; }
+
+    shape_t shape() const { return shape_; }
+
+    template <typename... I> R &at(I... i) const
+    {
+        return data_[shape_.offset(i...)];
+    }
+
+    subspace_t operator[](dim_t i) const { return select<0>(i); }
+
+    //! The sub tensor at index i of the given axis, e.g. one channel.
+    template <rank_t axis> subspace_t select(dim_t i) const
+    {
+        return subspace_t(data_ + i * shape_.strides[axis],
+                          shape_.template drop<axis>());
+    }
+
+    //! The range [begin, end) of the given axis, e.g. a subset of channels.
+    template <rank_t axis = 0>
+    basic_strided_tensor_ref slice(dim_t begin, dim_t end) const
+    {
+        static_assert(axis < r, "invalid axis");
+        shape_t s = shape_;
+        s.dims[axis] = end - begin;
+        return basic_strided_tensor_ref(data_ + begin * shape_.strides[axis],
+                                        s);
+    }
+
+    //! Permutes the axes, axis i of the result is axis perm[i] of this.
+    basic_strided_tensor_ref
+    transpose(const std::array<rank_t, r> &perm) const
+    {
+        shape_t s = shape_;
+        for (rank_t i = 0; i < r; ++i) {
+            s.dims[i] = shape_.dims[perm[i]];
+            s.strides[i] = shape_.strides[perm[i]];
+        }
+        return basic_strided_tensor_ref(data_, s);
+    }
+
+  private:
+    shape_t shape_;
+    R *data_;
+};
+
+template <typename R, rank_t r, typename dim_t>
+basic_strided_tensor_ref<R, r, dim_t>
+strided(const basic_tensor_ref<R, r, basic_shape<r, dim_t>> &t)
+{
+    R *ptr = (R *)/* FIXME */ t.data();
+    return basic_strided_tensor_ref<R, r, dim_t>(
+        ptr, basic_strided_shape<r, dim_t>(t.shape()));
+}
+
+template <typename R, rank_t r, typename dim_t, typename allocator_t>
+basic_strided_tensor_ref<R, r, dim_t>
+strided(const basic_tensor<R, r, basic_shape<r, dim_t>, allocator_t> &t)
+{
+    R *ptr = (R *)/* FIXME */ t.data();
+    return basic_strided_tensor_ref<R, r, dim_t>(
+        ptr, basic_strided_shape<r, dim_t>(t.shape()));
+}
+
+template <typename R, rank_t r, typename dim_t>
+basic_strided_tensor_ref<const R, r, dim_t>
+strided(const basic_tensor_view<R, r, basic_shape<r, dim_t>> &t)
+{
+    return basic_strided_tensor_ref<const R, r, dim_t>(
+        t.data(), basic_strided_shape<r, dim_t>(t.shape()));
+}
+}  // namespace internal
+}  // namespace ttl
@@ -1,6 +1,7 @@
 #pragma once
 #include <memory>
 
+#include <bits/std_allocator.hpp>
 #include <bits/std_shape.hpp>
 
 namespace ttl
@@ -13,7 +14,8 @@ namespace internal
 template <typename R, rank_t r, typename shape_t, typename elem_t>
 class basic_tensor_iterator;
 
-template <typename R, rank_t r, typename shape_t> class basic_tensor;
+template <typename R, rank_t r, typename shape_t, typename allocator_t>
+class basic_tensor;
 template <typename R, rank_t r, typename shape_t> class basic_tensor_ref;
 template <typename R, rank_t r, typename shape_t> class basic_tensor_view;
 
@@ -52,7 +54,8 @@ template <typename R, typename shape_t> class basic_tensor_ref<R, 0, shape_t>
 
     explicit basic_tensor_ref(R *data, const shape_t &) : data_(data) {}
 
-    basic_tensor_ref(const basic_tensor<R, 0, shape_t> &t)
+    template <typename allocator_t>
+    basic_tensor_ref(const basic_tensor<R, 0, shape_t, allocator_t> &t)
         : data_((R *)t.data())
     {
     }
@@ -75,7 +78,11 @@ template <typename R, typename shape_t> class basic_tensor_view<R, 0, shape_t>
 
     basic_tensor_view(const R *data, const shape_t &) : data_(data) {}
 
-    basic_tensor_view(const basic_tensor<R, 0, shape_t> &t) : data_(t.data()) {}
+    template <typename allocator_t>
+    basic_tensor_view(const basic_tensor<R, 0, shape_t, allocator_t> &t)
+        : data_(t.data())
+    {
+    }
 
     basic_tensor_view(const basic_tensor_ref<R, 0, shape_t> &t)
         : data_(t.data())
@@ -85,14 +92,26 @@ template <typename R, typename shape_t> class basic_tensor_view<R, 0, shape_t>
     const R *data() const { return data_; }
 };
 
-template <typename R, typename shape_t> class basic_tensor<R, 0, shape_t>
+template <typename R, typename shape_t, typename allocator_t>
+class basic_tensor<R, 0, shape_t, allocator_t>
 {
-    std::unique_ptr<R[]> data_;
+    using deleter_t = tensor_deleter<R, allocator_t>;
+
+    std::unique_ptr<R[], deleter_t> data_;
 
   public:
     static constexpr rank_t rank = 0;
 
-    basic_tensor() : data_(new R[1]) {}
+    explicit basic_tensor(const allocator_t &allocator = allocator_t())
+        : data_(nullptr, deleter_t(allocator, 1))
+    {
+        allocator_t a = allocator;
+        data_.reset(deleter_t::create(a, 1));
+    }
+
+    R *data() { return data_.get(); }
+
+    const R *data() const { return data_.get(); }
 
     using base_t = R;  // FIXME: deprecate
 };
@@ -109,18 +128,46 @@ R scalar(const basic_tensor_view<R, 0, shape_t> &t)
     return t.data()[0];
 }
 
-template <template <typename, rank_t, typename> class T, typename R, rank_t r,
-          typename shape_t>
-basic_tensor_ref<R, r, shape_t> ref(const T<R, r, shape_t> &t)
+template <typename R, rank_t r, typename shape_t>
+basic_tensor_ref<R, r, shape_t> ref(const basic_tensor_ref<R, r, shape_t> &t)
+{
+    const R *const c_ptr = t.data();
+    R *ptr = (R *)/* FIXME */ c_ptr;
+    return basic_tensor_ref<R, r, shape_t>(ptr, t.shape());
+}
+
+template <typename R, rank_t r, typename shape_t>
+basic_tensor_ref<R, r, shape_t> ref(const basic_tensor_view<R, r, shape_t> &t)
+{
+    const R *const c_ptr = t.data();
+    R *ptr = (R *)/* FIXME */ c_ptr;
+    return basic_tensor_ref<R, r, shape_t>(ptr, t.shape());
+}
+
+template <typename R, rank_t r, typename shape_t, typename allocator_t>
+basic_tensor_ref<R, r, shape_t>
+ref(const basic_tensor<R, r, shape_t, allocator_t> &t)
 {
     const R *const c_ptr = t.data();
     R *ptr = (R *)/* FIXME */ c_ptr;
     return basic_tensor_ref<R, r, shape_t>(ptr, t.shape());
 }
 
-template <template <typename, rank_t, typename> class T, typename R, rank_t r,
-          typename shape_t>
-basic_tensor_view<R, r, shape_t> view(const T<R, r, shape_t> &t)
+template <typename R, rank_t r, typename shape_t>
+basic_tensor_view<R, r, shape_t> view(const basic_tensor_ref<R, r, shape_t> &t)
+{
+    return basic_tensor_view<R, r, shape_t>(t.data(), t.shape());
+}
+
+template <typename R, rank_t r, typename shape_t>
+basic_tensor_view<R, r, shape_t> view(const basic_tensor_view<R, r, shape_t> &t)
+{
+    return basic_tensor_view<R, r, shape_t>(t.data(), t.shape());
+}
+
+template <typename R, rank_t r, typename shape_t, typename allocator_t>
+basic_tensor_view<R, r, shape_t>
+view(const basic_tensor<R, r, shape_t, allocator_t> &t)
 {
     return basic_tensor_view<R, r, shape_t>(t.data(), t.shape());
 }
@@ -178,7 +225,8 @@ class basic_tensor_ref
     {
     }
 
-    basic_tensor_ref(const basic_tensor<R, r, shape_t> &t)
+    template <typename allocator_t>
+    basic_tensor_ref(const basic_tensor<R, r, shape_t, allocator_t> &t)
         : shape_(t.shape()), data_((R *)t.data())
     {
     }
@@ -240,7 +288,8 @@ class basic_tensor_view
     {
     }
 
-    basic_tensor_view(const basic_tensor<R, r, shape_t> &t)
+    template <typename allocator_t>
+    basic_tensor_view(const basic_tensor<R, r, shape_t, allocator_t> &t)
         : shape_(t.shape()), data_(t.data())
     {
     }
@@ -273,24 +322,53 @@ class basic_tensor_view
     }
 };
 
-template <typename R, rank_t r, typename shape_t = basic_shape<r>>
+/*! An owning tensor. Memory comes from allocator_t, which defaults to a
+    64-byte aligned allocator, see pooled_allocator for reusing memory.
+    Tensors are movable but not copyable.
+*/
+template <typename R, rank_t r, typename shape_t = basic_shape<r>,
+          typename allocator_t = aligned_allocator<R>>
 class basic_tensor
 {
     using subshape_shape_t = typename shape_t::template subshape_t<1>;
     using subspace_ref_t = basic_tensor_ref<R, r - 1, subshape_shape_t>;
     using iterator =
         basic_tensor_iterator<R, r - 1, subshape_shape_t, subspace_ref_t>;
+    using deleter_t = tensor_deleter<R, allocator_t>;
 
-    const shape_t shape_;
-    std::unique_ptr<R[]> data_;
+    shape_t shape_;
+    std::unique_ptr<R[], deleter_t> data_;
 
   public:
     static constexpr rank_t rank = r;
 
     template <typename... D>
     constexpr explicit basic_tensor(D... d)
-        : shape_(d...), data_(new R[shape_.size()])
+        : basic_tensor(shape_t(d...), allocator_t())
+    {
+    }
+
+    template <typename... D>
+    explicit basic_tensor(const allocator_t &allocator, D... d)
+        : basic_tensor(shape_t(d...), allocator)
+    {
+    }
+
+    explicit basic_tensor(const shape_t &shape,
+                          const allocator_t &allocator = allocator_t())
+        : shape_(shape), data_(nullptr, deleter_t(allocator, shape.size()))
+    {
+        allocator_t a = allocator;
+        data_.reset(deleter_t::create(a, shape_.size()));
+    }
+
+    basic_tensor(basic_tensor &&) = default;
+
+    basic_tensor &operator=(basic_tensor &&) = default;
+
+    allocator_t get_allocator() const
     {
+        return data_.get_deleter().get_allocator();
     }
 
     R *data() { return data_.get(); }
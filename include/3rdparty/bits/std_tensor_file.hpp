@@ -0,0 +1,282 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <bits/std_half.hpp>
+#include <bits/std_shape.hpp>
+#include <bits/std_tensor.hpp>
+
+namespace ttl
+{
+namespace internal
+{
+/*! On-disk layout of a tensor file.
+
+    [header: 64 bytes][frame 0][frame 1]...
+
+    All frames share the dtype and shape given in the header, each frame is
+    the raw row-major data, padded to a multiple of 64 bytes, so every frame
+    is 64-byte aligned when the file is mapped.
+*/
+struct tensor_file_header_t {
+    static constexpr uint32_t magic_value = 0x544c5454;  // "TTLT"
+    static constexpr uint16_t current_version = 1;
+    static constexpr uint8_t max_rank = 8;
+    static constexpr size_t alignment = 64;
+
+    uint32_t magic;
+    uint16_t version;
+    uint8_t dtype;
+    uint8_t rank;
+    uint32_t n_frames;
+    uint32_t dims[max_rank];
+    uint8_t _padding[alignment - 12 - 4 * max_rank];
+};
+
+static_assert(sizeof(tensor_file_header_t) == tensor_file_header_t::alignment,
+              "invalid tensor file header size");
+
+template <typename R> struct dtype_code;
+template <> struct dtype_code<uint8_t> {
+    static constexpr uint8_t value = 1;
+};
+template <> struct dtype_code<int8_t> {
+    static constexpr uint8_t value = 2;
+};
+template <> struct dtype_code<uint16_t> {
+    static constexpr uint8_t value = 3;
+};
+template <> struct dtype_code<int16_t> {
+    static constexpr uint8_t value = 4;
+};
+template <> struct dtype_code<uint32_t> {
+    static constexpr uint8_t value = 5;
+};
+template <> struct dtype_code<int32_t> {
+    static constexpr uint8_t value = 6;
+};
+template <> struct dtype_code<float> {
+    static constexpr uint8_t value = 7;
+};
+template <> struct dtype_code<double> {
+    static constexpr uint8_t value = 8;
+};
+template <> struct dtype_code<half> {
+    static constexpr uint8_t value = 9;
+};
+
+// 0 for an unknown dtype code
+inline size_t tensor_file_dtype_size(uint8_t dtype)
+{
+    static const size_t sizes[] = {0, 1, 1, 2, 2, 4, 4, 4, 8, 2};
+    return dtype < sizeof(sizes) / sizeof(sizes[0]) ? sizes[dtype] : 0;
+}
+
+inline size_t tensor_file_frame_size(size_t bytes)
+{
+    const size_t a = tensor_file_header_t::alignment;
+    return (bytes + a - 1) / a * a;
+}
+
+/*! Writes frames of the same dtype and shape to a tensor file.
+    The number of frames is written to the header by close().
+*/
+template <typename R, rank_t r> class tensor_file_writer
+{
+    static_assert(r <= tensor_file_header_t::max_rank, "rank too large");
+
+  public:
+    tensor_file_writer(const std::string &filename, const basic_shape<r> &shape)
+        : shape_(shape), fp(std::fopen(filename.c_str(), "wb"))
+    {
+        if (fp == nullptr) {
+            throw std::runtime_error("can't open " + filename);
+        }
+        std::memset(&header, 0, sizeof(header));
+        header.magic = tensor_file_header_t::magic_value;
+        header.version = tensor_file_header_t::current_version;
+        header.dtype = dtype_code<R>::value;
+        header.rank = r;
+        for (rank_t i = 0; i < r; ++i) { header.dims[i] = shape.dims[i]; }
+        if (!write_header()) {
+            std::fclose(fp);
+            throw std::runtime_error("failed to write tensor file");
+        }
+    }
+
+    // errors are only reported by an explicit close()
+    ~tensor_file_writer()
+    {
+        if (fp) {
+            write_header();
+            std::fclose(fp);
+        }
+    }
+
+    tensor_file_writer(const tensor_file_writer &) = delete;
+    tensor_file_writer &operator=(const tensor_file_writer &) = delete;
+
+    void append(const basic_tensor_view<R, r> &t)
+    {
+        for (rank_t i = 0; i < r; ++i) {
+            if (t.shape().dims[i] != shape_.dims[i]) {
+                throw std::invalid_argument("frame shape mismatch");
+            }
+        }
+        const size_t bytes = shape_.size() * sizeof(R);
+        static const char zeros[tensor_file_header_t::alignment] = {0};
+        if (std::fwrite(t.data(), 1, bytes, fp) != bytes ||
+            std::fwrite(zeros, 1, tensor_file_frame_size(bytes) - bytes, fp) !=
+                tensor_file_frame_size(bytes) - bytes) {
+            throw std::runtime_error("failed to write tensor file");
+        }
+        ++header.n_frames;
+    }
+
+    void close()
+    {
+        if (fp) {
+            const bool ok = write_header();
+            const bool closed = std::fclose(fp) == 0;
+            fp = nullptr;
+            if (!ok || !closed) {
+                throw std::runtime_error("failed to write tensor file");
+            }
+        }
+    }
+
+  private:
+    const basic_shape<r> shape_;
+    std::FILE *fp;
+    tensor_file_header_t header;
+
+    bool write_header()
+    {
+        const long pos = std::ftell(fp);
+        if (pos < 0 || std::fseek(fp, 0, SEEK_SET) != 0 ||
+            std::fwrite(&header, sizeof(header), 1, fp) != 1) {
+            return false;
+        }
+        return pos == 0 || std::fseek(fp, pos, SEEK_SET) == 0;
+    }
+};
+
+template <typename R, rank_t r>
+void save_tensor(const std::string &filename, const basic_tensor_view<R, r> &t)
+{
+    tensor_file_writer<R, r> w(filename, t.shape());
+    w.append(t);
+    w.close();
+}
+
+template <typename R, rank_t r>
+void save_tensor(const std::string &filename, const basic_tensor_ref<R, r> &t)
+{
+    save_tensor(filename, view(t));
+}
+
+template <typename R, rank_t r, typename allocator_t>
+void save_tensor(const std::string &filename,
+                 const basic_tensor<R, r, basic_shape<r>, allocator_t> &t)
+{
+    save_tensor(filename, view(t));
+}
+
+/*! A read-only memory mapped tensor file.
+    Frames are returned as views into the mapping, without any copy.
+*/
+class mapped_tensor_file
+{
+  public:
+    explicit mapped_tensor_file(const std::string &filename)
+        : addr(MAP_FAILED), length(0), frame_size(0)
+    {
+        const int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) { throw std::runtime_error("can't open " + filename); }
+        struct stat st;
+        if (fstat(fd, &st) != 0 ||
+            st.st_size < (off_t)sizeof(tensor_file_header_t)) {
+            ::close(fd);
+            throw std::runtime_error("invalid tensor file " + filename);
+        }
+        length = st.st_size;
+        addr = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error("can't mmap " + filename);
+        }
+
+        const auto &h = header();
+        if (h.magic == tensor_file_header_t::magic_value &&
+            h.version == tensor_file_header_t::current_version &&
+            h.rank <= tensor_file_header_t::max_rank) {
+            frame_size = checked_frame_size(h);
+        }
+        if (frame_size == 0 ||
+            h.n_frames >
+                (length - sizeof(tensor_file_header_t)) / frame_size) {
+            munmap(addr, length);
+            throw std::runtime_error("invalid tensor file " + filename);
+        }
+    }
+
+    ~mapped_tensor_file()
+    {
+        if (addr != MAP_FAILED) { munmap(addr, length); }
+    }
+
+    mapped_tensor_file(const mapped_tensor_file &) = delete;
+    mapped_tensor_file &operator=(const mapped_tensor_file &) = delete;
+
+    const tensor_file_header_t &header() const
+    {
+        return *static_cast<const tensor_file_header_t *>(addr);
+    }
+
+    uint32_t frames() const { return header().n_frames; }
+
+    //! The i-th frame, throws if R or r doesn't match the file.
+    template <typename R, rank_t r>
+    basic_tensor_view<R, r> view(uint32_t i = 0) const
+    {
+        const auto &h = header();
+        if (h.dtype != dtype_code<R>::value || h.rank != r) {
+            throw std::invalid_argument("tensor type mismatch");
+        }
+        if (i >= h.n_frames) { throw std::out_of_range("invalid frame"); }
+        std::array<uint32_t, r> dims;
+        for (rank_t j = 0; j < r; ++j) { dims[j] = h.dims[j]; }
+        const char *p = static_cast<const char *>(addr) +
+                        sizeof(tensor_file_header_t) + i * frame_size;
+        return basic_tensor_view<R, r>(reinterpret_cast<const R *>(p),
+                                       basic_shape<r>(dims));
+    }
+
+  private:
+    void *addr;
+    size_t length;
+    size_t frame_size;
+
+    // 0 for an unknown dtype, an empty shape, or a size that overflows
+    static size_t checked_frame_size(const tensor_file_header_t &h)
+    {
+        size_t n = tensor_file_dtype_size(h.dtype);
+        for (uint8_t j = 0; j < h.rank; ++j) {
+            if (h.dims[j] == 0 || n > SIZE_MAX / h.dims[j]) { return 0; }
+            n *= h.dims[j];
+        }
+        if (n > SIZE_MAX - tensor_file_header_t::alignment) { return 0; }
+        return tensor_file_frame_size(n);
+    }
+};
+}  // namespace internal
+}  // namespace ttl
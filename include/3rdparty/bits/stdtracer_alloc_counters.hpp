@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+
+// Counters of the calling thread, updated by the operator new/delete
+// replacements of <stdtracer_alloc_hooks>. Constant initialized, so it is
+// safe to use from operator new at any point of a thread's life.
+struct alloc_counters_t {
+    uint64_t allocs;
+    uint64_t bytes;
+    uint64_t frees;
+    uint32_t paused;  // nothing is counted while > 0
+};
+
+inline alloc_counters_t &thread_alloc_counters()
+{
+    static thread_local alloc_counters_t c = {0, 0, 0, 0};
+    return c;
+}
+
+/*! Stops counting the allocations of this thread from construction until
+    resume(), so that the bookkeeping of the tracer, e.g. copies of scope
+    names or first-time registrations, isn't counted against the scopes.
+*/
+class alloc_pause_t
+{
+  public:
+    alloc_pause_t() : paused(false) { pause(); }
+
+    ~alloc_pause_t() { resume(); }
+
+    alloc_pause_t(const alloc_pause_t &) = delete;
+    alloc_pause_t &operator=(const alloc_pause_t &) = delete;
+
+    void pause()
+    {
+        if (!paused) {
+            ++thread_alloc_counters().paused;
+            paused = true;
+        }
+    }
+
+    void resume()
+    {
+        if (paused) {
+            --thread_alloc_counters().paused;
+            paused = false;
+        }
+    }
+
+  private:
+    bool paused;
+};
@@ -0,0 +1,178 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "stdtracer_alloc_counters.hpp"
+#include "stdtracer_per_thread.hpp"
+
+/*! Attributes heap allocations to trace scopes.
+
+    Reports, per call of each scope, the allocations made while it was the
+    innermost active scope (self) and including nested scopes (total).
+    Counting needs <stdtracer_alloc_hooks> in exactly one translation unit,
+    without it all counts are zero. The report is appended to the report of
+    another context, usually default_simple_ctx, i.e. to trace.log.
+*/
+template <typename clock_t, typename duration_t> class alloc_tracer_ctx_t_
+{
+  public:
+    template <typename report_ctx_t>
+    alloc_tracer_ctx_t_(const std::string &name, report_ctx_t &report_ctx)
+        : data(std::make_shared<data_t>(name))
+    {
+        const auto d = data;
+        report_ctx.add_reporter([d](FILE *fp) { d->report(fp); });
+    }
+
+    void in(const std::string &name)
+    {
+        alloc_pause_t _;
+        auto &l = data->locals.local();
+        const auto &c = thread_alloc_counters();
+        l.stack.push_back(frame_t{c.allocs, c.bytes, 0, 0});
+    }
+
+    void out(const std::string &name, const duration_t &d)
+    {
+        alloc_pause_t _;
+        auto &l = data->locals.local();
+        const auto &c = thread_alloc_counters();
+        const frame_t f = l.stack.back();
+        l.stack.pop_back();
+        const uint64_t allocs = c.allocs - f.allocs;
+        const uint64_t bytes = c.bytes - f.bytes;
+        if (!l.stack.empty()) {
+            l.stack.back().child_allocs += allocs;
+            l.stack.back().child_bytes += bytes;
+        }
+
+        auto &s = l.stats.at(data->names.id(name, l.ids));
+        inc(s.count, 1);
+        inc(s.ns,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+        inc(s.allocs, allocs);
+        inc(s.bytes, bytes);
+        inc(s.self_allocs, allocs - f.child_allocs);
+        inc(s.self_bytes, bytes - f.child_bytes);
+    }
+
+    void report(FILE *fp) const { data->report(fp); }
+
+    struct summary_t {
+        std::string name;
+        uint64_t count = 0;
+        uint64_t ns = 0;
+        uint64_t allocs = 0;
+        uint64_t bytes = 0;
+        uint64_t self_allocs = 0;
+        uint64_t self_bytes = 0;
+    };
+
+    //! The totals of each scope over all threads.
+    std::vector<summary_t> summaries() const { return data->merge(); }
+
+  private:
+    struct frame_t {
+        uint64_t allocs;
+        uint64_t bytes;
+        uint64_t child_allocs;
+        uint64_t child_bytes;
+    };
+
+    struct stats_t {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> ns;
+        std::atomic<uint64_t> allocs;
+        std::atomic<uint64_t> bytes;
+        std::atomic<uint64_t> self_allocs;
+        std::atomic<uint64_t> self_bytes;
+    };
+
+    struct local_t {
+        std::vector<frame_t> stack;
+        string_registry_t::cache_t ids;
+        slot_array_t<stats_t> stats;
+
+        // so that growing the stack doesn't count against the scopes
+        local_t() { stack.reserve(64); }
+    };
+
+    // shared with the reporter, which may outlive this context
+    struct data_t {
+        const std::string name;
+        string_registry_t names;
+        per_thread_t<local_t> locals;
+
+        explicit data_t(const std::string &name) : name(name) {}
+
+        std::vector<summary_t> merge() const
+        {
+            const auto ns = names.names();
+            std::vector<summary_t> list(ns.size());
+            for (uint32_t i = 0; i < ns.size(); ++i) { list[i].name = ns[i]; }
+            locals.for_each([&](const local_t &l) {
+                for (uint32_t i = 0; i < ns.size(); ++i) {
+                    const auto *s = l.stats.find(i);
+                    if (s == nullptr) { continue; }
+                    auto &it = list[i];
+                    it.count += s->count.load(std::memory_order_relaxed);
+                    it.ns += s->ns.load(std::memory_order_relaxed);
+                    it.allocs += s->allocs.load(std::memory_order_relaxed);
+                    it.bytes += s->bytes.load(std::memory_order_relaxed);
+                    it.self_allocs +=
+                        s->self_allocs.load(std::memory_order_relaxed);
+                    it.self_bytes +=
+                        s->self_bytes.load(std::memory_order_relaxed);
+                }
+            });
+            list.erase(std::remove_if(
+                           list.begin(), list.end(),
+                           [](const summary_t &it) { return it.count == 0; }),
+                       list.end());
+            return list;
+        }
+
+        void report(FILE *fp) const
+        {
+            auto list = merge();
+            if (list.empty()) { return; }
+            std::sort(list.begin(), list.end(),
+                      [](const summary_t &a, const summary_t &b) {
+                          return a.self_bytes > b.self_bytes;
+                      });
+
+            const std::string hr(116, '-');
+            fprintf(fp, "\tallocations of %s::%s\n", "alloc_tracer_ctx_t_",
+                    name.c_str());
+            fprintf(fp, "%s\n", hr.c_str());
+            fprintf(fp, "%8s    %12s    %12s    %12s    %12s    %12s    %s\n",
+                    "count", "mean (ms)", "allocs/call", "KB/call",
+                    "self allocs", "self KB", "call site");
+            fprintf(fp, "%s\n", hr.c_str());
+            for (const auto &it : list) {
+                const double n = it.count;
+                fprintf(fp,
+                        "%8lu    %12.4f    %12.1f    %12.2f    %12.1f    "
+                        "%12.2f    %s\n",
+                        (unsigned long)it.count, it.ns / n * 1e-6,
+                        it.allocs / n, it.bytes / n / 1024,
+                        it.self_allocs / n, it.self_bytes / n / 1024,
+                        it.name.c_str());
+            }
+        }
+    };
+
+    const std::shared_ptr<data_t> data;
+
+    static void inc(std::atomic<uint64_t> &x, uint64_t d)
+    {
+        x.store(x.load(std::memory_order_relaxed) + d,
+                std::memory_order_relaxed);
+    }
+};
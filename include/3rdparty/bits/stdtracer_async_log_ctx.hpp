@@ -0,0 +1,284 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "stdtracer_log_ctx.hpp"
+#include "stdtracer_per_thread.hpp"
+
+/*! A bounded lock-free ring for many producers and a single consumer.
+
+    Each cell carries a sequence number telling whether it is free for the
+    producer of a given position, or filled for the consumer. push() fails
+    instead of waiting when the ring is full.
+*/
+template <typename T> class mpsc_ring_t
+{
+  public:
+    explicit mpsc_ring_t(size_t capacity)
+        : mask(round_up(capacity) - 1), cells(new cell_t[mask + 1]),
+          head(0), tail(0)
+    {
+        for (size_t i = 0; i <= mask; ++i) {
+            cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename F> bool push(const F &fill)
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        cell_t *c;
+        for (;;) {
+            c = &cells[pos & mask];
+            const size_t seq = c->seq.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1,
+                                               std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        fill(c->value);
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // only called by the consumer
+    bool pop(T &value)
+    {
+        cell_t &c = cells[head & mask];
+        if (c.seq.load(std::memory_order_acquire) != head + 1) {
+            return false;
+        }
+        value = c.value;
+        c.seq.store(head + mask + 1, std::memory_order_release);
+        ++head;
+        return true;
+    }
+
+  private:
+    struct cell_t {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    const size_t mask;
+    const std::unique_ptr<cell_t[]> cells;
+    size_t head;  // owned by the consumer
+    alignas(64) std::atomic<size_t> tail;
+
+    static size_t round_up(size_t n)
+    {
+        size_t m = 1;
+        while (m < n) { m <<= 1; }
+        return m;
+    }
+};
+
+/*! Same output as log_tracer_ctx_t_, but the traced thread only copies a
+    fixed-size record into a lock-free ring, and a background thread does
+    the formatting and the I/O. Records are dropped and counted when the
+    ring is full, scope names longer than a record are truncated.
+*/
+template <typename clock_t, typename duration_t> class async_log_tracer_ctx_t_
+{
+  public:
+    explicit async_log_tracer_ctx_t_(
+        const std::string &name, size_t capacity = 1 << 14,
+        std::chrono::milliseconds flush_interval = std::chrono::milliseconds(5))
+        : name(name), t0(clock_t::now()), flush_interval(flush_interval),
+          ring(capacity), dropped(0), stopped(false),
+          writer([this] { run(); })
+    {
+    }
+
+    ~async_log_tracer_ctx_t_()
+    {
+        stopped.store(true, std::memory_order_release);
+        writer.join();
+        const size_t n = dropped.load(std::memory_order_relaxed);
+        if (n > 0) {
+            fprintf(stderr, "// %zu log records dropped by %s\n", n,
+                    name.c_str());
+        }
+    }
+
+    void in(const std::string &name)
+    {
+        int &d = depth();
+        push(scope_in, d++, 0, name.c_str(), name.size());
+    }
+
+    void out(const std::string &name, const duration_t &d)
+    {
+        push(scope_out, --depth(), d.count(), name.c_str(), name.size());
+    }
+
+    template <typename... Args> void logf(const Args &... args)
+    {
+        const int d = depth();
+        if (!ring.push([&](record_t &r) {
+                r.kind = message;
+                r.depth = d;
+                snprintf(r.text, sizeof(r.text), args...);
+            })) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    //! Sends logf messages to fp until pop_log_file(), which closes it.
+    void push_log_file(FILE *fp, const std::string &filename)
+    {
+        push_control(log_file_push, fp, filename);
+    }
+
+    void pop_log_file(const std::string &filename)
+    {
+        push_control(log_file_pop, nullptr, filename);
+    }
+
+  private:
+    enum kind_t : uint8_t {
+        scope_in,
+        scope_out,
+        message,
+        log_file_push,
+        log_file_pop,
+    };
+
+    struct record_t {
+        kind_t kind;
+        int32_t depth;
+        double seconds;
+        FILE *fp;
+        char text[104];
+    };
+
+    const std::string name;
+    const std::chrono::time_point<clock_t> t0;
+    const std::chrono::milliseconds flush_interval;
+
+    mpsc_ring_t<record_t> ring;
+    std::atomic<size_t> dropped;
+    std::atomic<bool> stopped;
+
+    struct local_t {
+        int depth = 0;
+    };
+    per_thread_t<local_t> locals;
+
+    std::deque<FILE *> log_files;  // owned by the writer
+    std::thread writer;
+
+    int &depth() { return locals.local().depth; }
+
+    void push(kind_t kind, int depth, double seconds, const char *text,
+              size_t len)
+    {
+        if (!ring.push([&](record_t &r) {
+                r.kind = kind;
+                r.depth = depth;
+                r.seconds = seconds;
+                len = std::min(len, sizeof(r.text) - 1);
+                std::memcpy(r.text, text, len);
+                r.text[len] = '\0';
+            })) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // log files must follow the messages around them, so they are not
+    // dropped
+    void push_control(kind_t kind, FILE *fp, const std::string &filename)
+    {
+        const int d = depth();
+        while (!ring.push([&](record_t &r) {
+            r.kind = kind;
+            r.depth = d;
+            r.fp = fp;
+            const size_t len = std::min(filename.size(), sizeof(r.text) - 1);
+            std::memcpy(r.text, filename.c_str(), len);
+            r.text[len] = '\0';
+        })) {
+            std::this_thread::yield();
+        }
+    }
+
+    void run()
+    {
+        log_files.push_front(stdout);
+        size_t reported = 0;
+        for (;;) {
+            const bool last = stopped.load(std::memory_order_acquire);
+            record_t r;
+            while (ring.pop(r)) { write(r); }
+            const size_t n = dropped.load(std::memory_order_relaxed);
+            if (n > reported) {
+                printf("// %zu log records dropped\n", n - reported);
+                reported = n;
+            }
+            fflush(stdout);
+            if (log_files.front() != stdout) { fflush(log_files.front()); }
+            if (last) { break; }
+            std::this_thread::sleep_for(flush_interval);
+        }
+    }
+
+    void write(const record_t &r)
+    {
+        switch (r.kind) {
+        case scope_in:
+            indent(stdout, r.depth);
+            WITH_XTERM(1, 35, printf("{ // [%s]", r.text));
+            putchar('\n');
+            break;
+        case scope_out:
+            indent(stdout, r.depth);
+            if (r.seconds < 1) {
+                WITH_XTERM(1, 32, printf("} // [%s] took %.2fms", r.text,
+                                         r.seconds * 1000));
+            } else {
+                WITH_XTERM(1, 32,
+                           printf("} // [%s] took %.2fs", r.text, r.seconds));
+            }
+            putchar('\n');
+            break;
+        case message: {
+            FILE *fp = log_files.front();
+            if (fp == stdout) { indent(fp, r.depth); }
+            fprintf(fp, "// %s\n", r.text);
+            break;
+        }
+        case log_file_push:
+            log_files.push_front(r.fp);
+            indent(stdout, r.depth);
+            printf("// start logging to %s\n", r.text);
+            break;
+        case log_file_pop:
+            indent(stdout, r.depth);
+            printf("// stop logging to file://%s\n", r.text);
+            if (log_files.front() != stdout) {
+                std::fclose(log_files.front());
+                log_files.pop_front();
+            }
+            break;
+        }
+    }
+
+    static void indent(FILE *fp, int depth)
+    {
+        for (int i = 0; i < depth; ++i) { fprintf(fp, "    "); }
+    }
+};
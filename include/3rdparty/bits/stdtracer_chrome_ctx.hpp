@@ -0,0 +1,213 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "stdtracer_base.hpp"
+#include "stdtracer_per_thread.hpp"
+
+/*! Records every scope as a complete event ("ph": "X") of the Chrome
+    trace-event format, which can be opened in Perfetto or chrome://tracing
+    to see how stages overlap across threads. Counters and gauges are
+    counter events ("ph": "C"), drawn as tracks of their values over time.
+
+    Events go to a per-thread buffer preallocated on the first event of a
+    thread, events past its capacity are dropped and counted.
+*/
+template <typename clock_t, typename duration_t> class chrome_tracer_ctx_t_
+{
+  public:
+    explicit chrome_tracer_ctx_t_(const std::string &name,
+                                  const std::string &filename = "trace.json",
+                                  size_t capacity = 1 << 16)
+        : name(name), filename(filename), capacity(capacity),
+          t0(clock_t::now())
+    {
+    }
+
+    ~chrome_tracer_ctx_t_()
+    {
+        if (names.size() > 0) {
+            fprintf(stderr, "// trace events logged to file://%s\n",
+                    filename.c_str());
+            FILE *fp = fopen(filename.c_str(), "w");
+            if (fp) {
+                dump(fp);
+                fclose(fp);
+            }
+        }
+    }
+
+    void in(const std::string &name) {}
+
+    void out(const std::string &name, const duration_t &d)
+    {
+        const double end = since<double, clock_t>(t0).count();
+        add(complete, name, (end - d.count()) * 1e6, d.count() * 1e6);
+    }
+
+    //! Adds value to a counter, shown as its running total over time.
+    void counter(const std::string &name, double value)
+    {
+        add(counter_delta, name, since<double, clock_t>(t0).count() * 1e6,
+            value);
+    }
+
+    //! Records the current value of a quantity, e.g. a queue depth.
+    void gauge(const std::string &name, double value)
+    {
+        add(gauge_value, name, since<double, clock_t>(t0).count() * 1e6,
+            value);
+    }
+
+    //! Names the calling thread in the trace, e.g. "camera".
+    void set_thread_name(const std::string &thread_name)
+    {
+        auto &l = local();
+        l.thread_name.store(names.id(thread_name, l.ids),
+                            std::memory_order_release);
+    }
+
+    //! Writes the events recorded so far, safe while other threads trace.
+    void dump(FILE *fp) const
+    {
+        const auto ns = names.names();
+        const int pid = getpid();
+        fprintf(fp, "{\"traceEvents\":[\n");
+        fprintf(fp,
+                "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                "\"args\":{\"name\":\"%s\"}}",
+                pid, escape(name).c_str());
+        size_t dropped = 0;
+        std::vector<event_t> deltas;
+        locals.for_each([&](const local_t &l) {
+            const int32_t tn = l.thread_name.load(std::memory_order_acquire);
+            if (tn >= 0) {
+                fprintf(fp,
+                        ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                        "\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                        pid, l.tid, escape(ns[tn]).c_str());
+            }
+            const size_t n = l.size.load(std::memory_order_acquire);
+            for (size_t i = 0; i < n; ++i) {
+                const event_t &e = l.events[i];
+                switch (e.kind) {
+                case complete:
+                    fprintf(fp,
+                            ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,"
+                            "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                            escape(ns[e.name]).c_str(), pid, l.tid, e.ts,
+                            e.value);
+                    break;
+                case gauge_value:
+                    dump_counter(fp, pid, ns[e.name], e.ts, e.value);
+                    break;
+                case counter_delta:
+                    deltas.push_back(e);
+                    break;
+                }
+            }
+            dropped += l.dropped.load(std::memory_order_relaxed);
+        });
+        // running totals over all threads, in time order
+        std::stable_sort(
+            deltas.begin(), deltas.end(),
+            [](const event_t &a, const event_t &b) { return a.ts < b.ts; });
+        std::vector<double> totals(ns.size());
+        for (const auto &e : deltas) {
+            totals[e.name] += e.value;
+            dump_counter(fp, pid, ns[e.name], e.ts, totals[e.name]);
+        }
+        fprintf(fp, "\n],\"displayTimeUnit\":\"ms\",");
+        fprintf(fp, "\"otherData\":{\"dropped_events\":%zu}}\n", dropped);
+    }
+
+  private:
+    const std::string name;
+    const std::string filename;
+    const size_t capacity;
+    const std::chrono::time_point<clock_t> t0;
+
+    enum kind_t : uint8_t { complete, counter_delta, gauge_value };
+
+    struct event_t {
+        uint32_t name;
+        kind_t kind;
+        double ts;     // in us since t0
+        double value;  // the duration in us, or the value of a counter
+    };
+
+    struct local_t {
+        const int tid = syscall(SYS_gettid);  // constructed by the thread
+        std::unique_ptr<event_t[]> events;
+        std::atomic<size_t> size{0};
+        std::atomic<size_t> dropped{0};
+        std::atomic<int32_t> thread_name{-1};
+        string_registry_t::cache_t ids;
+    };
+
+    string_registry_t names;
+    per_thread_t<local_t> locals;
+
+    local_t &local()
+    {
+        auto &l = locals.local();
+        if (!l.events) {  // first event of this thread
+            l.events.reset(new event_t[capacity]);
+        }
+        return l;
+    }
+
+    void add(kind_t kind, const std::string &name, double ts, double value)
+    {
+        auto &l = local();
+        const size_t n = l.size.load(std::memory_order_relaxed);
+        if (n >= capacity) {
+            l.dropped.store(l.dropped.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_relaxed);
+            return;
+        }
+        event_t &e = l.events[n];
+        e.name = names.id(name, l.ids);
+        e.kind = kind;
+        e.ts = ts;
+        e.value = value;
+        l.size.store(n + 1, std::memory_order_release);
+    }
+
+    // counters are per process ("ph": "C"), not per thread
+    static void dump_counter(FILE *fp, int pid, const std::string &name,
+                             double ts, double value)
+    {
+        fprintf(fp,
+                ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":%d,"
+                "\"ts\":%.3f,\"args\":{\"value\":%.17g}}",
+                escape(name).c_str(), pid, ts, value);
+    }
+
+    static std::string escape(const std::string &s)
+    {
+        std::string t;
+        for (const char c : s) {
+            if (c == '"' || c == '\\') {
+                t += '\\';
+                t += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                t += buf;
+            } else {
+                t += c;
+            }
+        }
+        return t;
+    }
+};
@@ -0,0 +1,169 @@
+#pragma once
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*! Snapshots a context with export_prometheus(FILE *), e.g.
+    simple_tracer_ctx_t, every interval on a background thread, so that
+    long-running processes can be monitored without waiting for the report
+    at exit.
+
+    path is either a file, replaced atomically (write then rename), e.g. a
+    *.prom file in the directory of the node exporter textfile collector,
+    or "unix:<socket path>", where each connection receives the latest
+    snapshot, e.g. `socat - UNIX-CONNECT:<socket path>`.
+    An empty path disables the exporter. The context must outlive it.
+*/
+template <typename ctx_t> class metrics_exporter_t
+{
+  public:
+    metrics_exporter_t(const ctx_t &ctx, const std::string &path,
+                       std::chrono::milliseconds interval =
+                           std::chrono::milliseconds(10000))
+        : ctx(ctx), path(path), interval(interval), listen_fd(-1),
+          stopped(false)
+    {
+        if (path.empty()) { return; }
+        const std::string prefix = "unix:";
+        if (path.compare(0, prefix.size(), prefix) == 0) {
+            listen_fd = listen_unix(path.substr(prefix.size()));
+            if (listen_fd < 0) { return; }
+        }
+        worker = std::thread([this] { run(); });
+    }
+
+    ~metrics_exporter_t()
+    {
+        stopped.store(true, std::memory_order_relaxed);
+        if (worker.joinable()) { worker.join(); }
+        if (listen_fd >= 0) {
+            close(listen_fd);
+            unlink(socket_path().c_str());
+        }
+    }
+
+    metrics_exporter_t(const metrics_exporter_t &) = delete;
+    metrics_exporter_t &operator=(const metrics_exporter_t &) = delete;
+
+  private:
+    const ctx_t &ctx;
+    const std::string path;
+    const std::chrono::milliseconds interval;
+    int listen_fd;
+    std::atomic<bool> stopped;
+    std::thread worker;
+
+    std::string socket_path() const { return path.substr(strlen("unix:")); }
+
+    void run()
+    {
+        std::string snapshot = render();
+        auto next = std::chrono::steady_clock::now() + interval;
+        for (;;) {
+            if (listen_fd < 0) { write_file(snapshot); }
+            if (!wait_until(next, snapshot)) { break; }
+            snapshot = render();
+            next = std::chrono::steady_clock::now() + interval;
+        }
+        // the final state, the socket is gone with the process
+        if (listen_fd < 0) { write_file(render()); }
+    }
+
+    // serves connections until t, returns false when stopped
+    bool wait_until(std::chrono::steady_clock::time_point t,
+                    const std::string &snapshot) const
+    {
+        const int poll_ms = 100;  // to stop promptly
+        while (std::chrono::steady_clock::now() < t) {
+            if (stopped.load(std::memory_order_relaxed)) { return false; }
+            if (listen_fd >= 0) {
+                pollfd p = {listen_fd, POLLIN, 0};
+                if (poll(&p, 1, poll_ms) > 0) { serve(snapshot); }
+            } else {
+                std::this_thread::sleep_for(
+                    std::chrono::milliseconds(poll_ms));
+            }
+        }
+        return !stopped.load(std::memory_order_relaxed);
+    }
+
+    std::string render() const
+    {
+        char *buf = nullptr;
+        size_t size = 0;
+        FILE *fp = open_memstream(&buf, &size);
+        if (fp == nullptr) { return ""; }
+        ctx.export_prometheus(fp);
+        fclose(fp);
+        std::string s(buf, size);
+        free(buf);
+        return s;
+    }
+
+    void write_file(const std::string &s) const
+    {
+        const std::string tmp = path + ".tmp";
+        FILE *fp = fopen(tmp.c_str(), "w");
+        if (fp == nullptr) {
+            fprintf(stderr, "// can't write metrics to %s: %s\n", tmp.c_str(),
+                    strerror(errno));
+            return;
+        }
+        const bool ok = fwrite(s.data(), 1, s.size(), fp) == s.size();
+        if (fclose(fp) != 0 || !ok ||
+            rename(tmp.c_str(), path.c_str()) != 0) {
+            fprintf(stderr, "// can't write metrics to %s: %s\n",
+                    path.c_str(), strerror(errno));
+        }
+    }
+
+    void serve(const std::string &s) const
+    {
+        const int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) { return; }
+        const timeval timeout = {1, 0};  // don't hang on a stuck client
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        for (size_t off = 0; off < s.size();) {
+            const ssize_t n =
+                send(fd, s.data() + off, s.size() - off, MSG_NOSIGNAL);
+            if (n <= 0) { break; }
+            off += n;
+        }
+        close(fd);
+    }
+
+    static int listen_unix(const std::string &socket_path)
+    {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(addr.sun_path)) {
+            fprintf(stderr, "// metrics socket path too long: %s\n",
+                    socket_path.c_str());
+            return -1;
+        }
+        std::strcpy(addr.sun_path, socket_path.c_str());
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) { return -1; }
+        unlink(socket_path.c_str());  // left over by a previous run
+        if (bind(fd, (const sockaddr *)&addr, sizeof(addr)) != 0 ||
+            listen(fd, 8) != 0) {
+            fprintf(stderr, "// can't listen on %s: %s\n",
+                    socket_path.c_str(), strerror(errno));
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+};
@@ -0,0 +1,140 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "stdtracer_per_thread.hpp"
+#include "stdtracer_tsc.hpp"
+
+/*! A flat tracer context for fine-grained scopes.
+
+    Scope names are interned into ids once per call site (see
+    fast_scope_t and stdtracer_fast), and durations are kept in raw TSC
+    ticks, so recording a scope is a thread-local lookup and a few relaxed
+    stores, with no string, lock or clock conversion.
+*/
+class fast_tracer_ctx_t
+{
+  public:
+    explicit fast_tracer_ctx_t(const std::string &name)
+        : name(name), t0(read_tsc())
+    {
+        tsc_clock::ns_per_tick();  // calibrate before the first scope
+    }
+
+    ~fast_tracer_ctx_t()
+    {
+        if (names.size() > 0) { report(stdout); }
+    }
+
+    //! Returns the id of a scope name, call once per call site.
+    uint32_t intern(const std::string &name) { return names.id(name); }
+
+    void add(uint32_t id, uint64_t ticks)
+    {
+        auto &s = locals.local().stats.at(id);
+        s.count.store(s.count.load(std::memory_order_relaxed) + 1,
+                      std::memory_order_relaxed);
+        s.ticks.store(s.ticks.load(std::memory_order_relaxed) + ticks,
+                      std::memory_order_relaxed);
+        if (ticks > s.max.load(std::memory_order_relaxed)) {
+            s.max.store(ticks, std::memory_order_relaxed);
+        }
+    }
+
+    // for scope_t_, slower than fast_scope_t since the name is looked up
+    void in(const std::string &name) {}
+
+    template <typename duration_t>
+    void out(const std::string &name, const duration_t &d)
+    {
+        const double ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+        add(names.id(name, locals.local().ids), ns / tsc_clock::ns_per_tick());
+    }
+
+    void report(FILE *fp) const
+    {
+        const double s_per_tick = tsc_clock::ns_per_tick() * 1e-9;
+        const double total = (read_tsc() - t0) * s_per_tick;
+
+        const auto ns = names.names();
+        std::vector<item_t> list(ns.size());
+        for (uint32_t i = 0; i < ns.size(); ++i) { list[i].name = ns[i]; }
+        locals.for_each([&](const local_t &l) {
+            for (uint32_t i = 0; i < ns.size(); ++i) {
+                const auto *s = l.stats.find(i);
+                if (s == nullptr) { continue; }
+                list[i].count += s->count.load(std::memory_order_relaxed);
+                list[i].ticks += s->ticks.load(std::memory_order_relaxed);
+                list[i].max = std::max(list[i].max,
+                                       s->max.load(std::memory_order_relaxed));
+            }
+        });
+        list.erase(std::remove_if(list.begin(), list.end(),
+                                  [](const item_t &it) { return it.count == 0; }),
+                   list.end());
+        std::sort(list.begin(), list.end(),
+                  [](const item_t &a, const item_t &b) {
+                      return a.ticks > b.ticks;
+                  });
+
+        const std::string hr(80, '-');
+        fprintf(fp, "\tsummary of %s::%s (%fs)\n", "fast_tracer_ctx_t",
+                name.c_str(), total);
+        fprintf(fp, "%s\n", hr.c_str());
+        fprintf(fp, "%10s    %16s    %8s    %12s    %12s    %s\n",  //
+                "count", "cumulative (s)", "%", "mean (us)", "max (us)",
+                "call site");
+        fprintf(fp, "%s\n", hr.c_str());
+        for (const auto &it : list) {
+            const double t = it.ticks * s_per_tick;
+            fprintf(fp, "%10lu    %16f    %8.2f    %12.4f    %12.4f    %s\n",
+                    (unsigned long)it.count, t, t * 100 / total,
+                    1e6 * t / it.count, 1e6 * it.max * s_per_tick,
+                    it.name.c_str());
+        }
+    }
+
+  private:
+    const std::string name;
+    const uint64_t t0;
+
+    struct stats_t {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> ticks;
+        std::atomic<uint64_t> max;
+    };
+
+    struct local_t {
+        string_registry_t::cache_t ids;
+        slot_array_t<stats_t> stats;
+    };
+
+    struct item_t {
+        std::string name;
+        uint64_t count = 0;
+        uint64_t ticks = 0;
+        uint64_t max = 0;
+    };
+
+    string_registry_t names;
+    per_thread_t<local_t> locals;
+};
+
+template <typename ctx_t> class fast_scope_t
+{
+  public:
+    fast_scope_t(uint32_t id, ctx_t &ctx) : id(id), t0(read_tsc()), ctx(ctx) {}
+
+    ~fast_scope_t() { ctx.add(id, read_tsc() - t0); }
+
+  private:
+    const uint32_t id;
+    const uint64_t t0;
+    ctx_t &ctx;
+};
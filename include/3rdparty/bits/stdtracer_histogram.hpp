@@ -0,0 +1,106 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*! A log-linear (HDR style) histogram of durations in ns.
+
+    Values are grouped by power of two, and each group is split into
+    sub_count linear buckets, so any recorded value is reported with a
+    relative error below 1 / sub_count. Memory is fixed and recording is
+    O(1). Written by one thread, readable by any.
+*/
+struct log_histogram_t {
+    static constexpr int sub_bits = 5;
+    static constexpr uint32_t sub_count = 1 << sub_bits;
+    static constexpr int max_bits = 40;  // larger values go to the last bucket
+    static constexpr uint32_t size = (max_bits - sub_bits + 1) * sub_count;
+
+    std::atomic<uint32_t> counts[size];
+    std::atomic<uint64_t> max;
+
+    void add(uint64_t v)
+    {
+        auto &c = counts[index(v)];
+        c.store(c.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+        if (v > max.load(std::memory_order_relaxed)) {
+            max.store(v, std::memory_order_relaxed);
+        }
+    }
+
+    static uint32_t index(uint64_t v)
+    {
+        if (v < sub_count) { return v; }
+        const int msb = 63 - __builtin_clzll(v);
+        if (msb >= max_bits) { return size - 1; }
+        const int shift = msb - sub_bits;
+        return (shift + 1) * sub_count + (v >> shift) - sub_count;
+    }
+
+    // the largest value that falls into bucket i
+    static uint64_t upper_bound(uint32_t i)
+    {
+        if (i < sub_count) { return i; }
+        const int shift = i / sub_count - 1;
+        const uint64_t lower = uint64_t(sub_count + i % sub_count) << shift;
+        return lower + (uint64_t(1) << shift) - 1;
+    }
+};
+
+//! The sum of log_histogram_t from several threads.
+class histogram_summary_t
+{
+  public:
+    histogram_summary_t() : counts(log_histogram_t::size), total(0), max_(0)
+    {
+    }
+
+    void merge(const log_histogram_t &h)
+    {
+        for (uint32_t i = 0; i < log_histogram_t::size; ++i) {
+            const uint32_t c = h.counts[i].load(std::memory_order_relaxed);
+            counts[i] += c;
+            total += c;
+        }
+        max_ = std::max(max_, h.max.load(std::memory_order_relaxed));
+    }
+
+    //! The value below which a fraction p of the samples fall.
+    uint64_t percentile(double p) const
+    {
+        if (total == 0) { return 0; }
+        const uint64_t rank =
+            std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p * total)));
+        uint64_t n = 0;
+        for (uint32_t i = 0; i < log_histogram_t::size; ++i) {
+            n += counts[i];
+            if (n >= rank) {
+                return std::min(log_histogram_t::upper_bound(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    uint64_t max() const { return max_; }
+
+    uint64_t count() const { return total; }
+
+    //! The number of samples up to v, with the resolution of the buckets.
+    uint64_t count_le(uint64_t v) const
+    {
+        uint64_t n = 0;
+        for (uint32_t i = 0; i < log_histogram_t::size; ++i) {
+            if (log_histogram_t::upper_bound(i) > v) { break; }
+            n += counts[i];
+        }
+        return n;
+    }
+
+  private:
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t max_;
+};
@@ -1,7 +1,9 @@
 #pragma once
 #include <algorithm>
 #include <chrono>
+#include <cstdio>
 #include <cstring>
+#include <deque>
 #include <sstream>
 #include <stack>
 #include <string>
@@ -9,6 +11,7 @@
 #include <unistd.h>
 
 #include "stdtracer_base.hpp"
+#include "stdtracer_per_thread.hpp"
 
 struct xterm_t {
     const bool is_tty;
@@ -33,7 +36,7 @@ template <typename clock_t, typename duration_t> class log_tracer_ctx_t_
 {
   public:
     explicit log_tracer_ctx_t_(const std::string &name)
-        : name(name), t0(clock_t::now()), depth(0)
+        : name(name), t0(clock_t::now())
     {
         log_files.push_front(stdout);
     }
@@ -45,12 +48,12 @@ template <typename clock_t, typename duration_t> class log_tracer_ctx_t_
         indent();
         WITH_XTERM(1, 35, printf("{ // [%s]", name.c_str()));
         putchar('\n');
-        ++depth;
+        ++depth();
     }
 
     void out(const std::string &name, const duration_t &d)
     {
-        --depth;
+        --depth();
 
         char buffer[128];
         sprintf(buffer, "[%s] took ", name.c_str());
@@ -68,7 +71,7 @@ template <typename clock_t, typename duration_t> class log_tracer_ctx_t_
 
     void indent(FILE *fp = stdout)
     {
-        for (int i = 0; i < depth; ++i) { fprintf(fp, "    "); }
+        for (int i = 0; i < depth(); ++i) { fprintf(fp, "    "); }
     }
 
     template <typename... Args> void logf1(FILE *fp, const Args &... args)
@@ -87,11 +90,34 @@ template <typename clock_t, typename duration_t> class log_tracer_ctx_t_
         }
     }
 
+    //! Sends logf messages to fp until pop_log_file(), which closes it.
+    void push_log_file(FILE *fp, const std::string &filename)
+    {
+        log_files.push_front(fp);
+        indent();
+        logf1(stdout, "start logging to %s", filename.c_str());
+    }
+
+    void pop_log_file(const std::string &filename)
+    {
+        indent();
+        logf1(stdout, "stop logging to file://%s", filename.c_str());
+        FILE *fp = log_files.front();
+        log_files.pop_front();
+        std::fclose(fp);
+    }
+
     std::deque<FILE *> log_files;
 
   private:
     const std::string name;
     const std::chrono::time_point<clock_t> t0;
 
-    int depth;
+    // indentation is per thread
+    struct local_t {
+        int depth = 0;
+    };
+    per_thread_t<local_t> locals;
+
+    int &depth() { return locals.local().depth; }
 };
@@ -0,0 +1,230 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "stdtracer_histogram.hpp"
+
+/*! Interns strings into dense ids shared by all threads.
+    Callers keep a per-thread cache, so the mutex is only taken the first
+    time a thread sees a string.
+*/
+class string_registry_t
+{
+  public:
+    using cache_t = std::unordered_map<std::string, uint32_t>;
+
+    uint32_t id(const std::string &s)
+    {
+        std::lock_guard<std::mutex> _(mu);
+        const auto pos = index.find(s);
+        if (pos != index.end()) { return pos->second; }
+        const uint32_t i = names_.size();
+        names_.push_back(s);
+        index[s] = i;
+        return i;
+    }
+
+    uint32_t id(const std::string &s, cache_t &cache)
+    {
+        const auto pos = cache.find(s);
+        if (pos != cache.end()) { return pos->second; }
+        return cache[s] = id(s);
+    }
+
+    std::vector<std::string> names() const
+    {
+        std::lock_guard<std::mutex> _(mu);
+        return names_;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> _(mu);
+        return names_.size();
+    }
+
+  private:
+    mutable std::mutex mu;
+    std::unordered_map<std::string, uint32_t> index;
+    std::vector<std::string> names_;
+};
+
+/*! A growable array with a single writer and lock-free readers.
+    Slots live in fixed size chunks that never move once allocated.
+*/
+template <typename slot_t> class slot_array_t
+{
+    static constexpr uint32_t chunk_size = 256;
+    static constexpr uint32_t max_chunks = 1024;
+
+  public:
+    slot_array_t()
+    {
+        for (auto &c : chunks) { c.store(nullptr, std::memory_order_relaxed); }
+    }
+
+    ~slot_array_t()
+    {
+        for (auto &c : chunks) { delete[] c.load(std::memory_order_relaxed); }
+    }
+
+    slot_array_t(const slot_array_t &) = delete;
+    slot_array_t &operator=(const slot_array_t &) = delete;
+
+    // writer only
+    slot_t &at(uint32_t i)
+    {
+        if (i / chunk_size >= max_chunks) {
+            throw std::length_error("too many trace slots");
+        }
+        auto &c = chunks[i / chunk_size];
+        slot_t *p = c.load(std::memory_order_relaxed);
+        if (p == nullptr) {
+            p = new slot_t[chunk_size]();
+            c.store(p, std::memory_order_release);
+        }
+        return p[i % chunk_size];
+    }
+
+    // any thread, nullptr if the slot was never written
+    const slot_t *find(uint32_t i) const
+    {
+        if (i / chunk_size >= max_chunks) { return nullptr; }
+        const slot_t *p = chunks[i / chunk_size].load(std::memory_order_acquire);
+        return p ? p + i % chunk_size : nullptr;
+    }
+
+  private:
+    std::atomic<slot_t *> chunks[max_chunks];
+};
+
+/*! Count, total duration and latency histogram of a scope, written by one
+    thread. Readers may see them from slightly different moments, which is
+    fine for a report. The histogram (~4.6KB) is allocated on the first
+    call, unless with_histogram is false.
+*/
+template <typename duration_t, bool with_histogram = true>
+struct call_stats_t {
+    using rep_t = typename duration_t::rep;
+
+    std::atomic<uint32_t> count;
+    std::atomic<rep_t> total;
+    std::atomic<log_histogram_t *> histogram;
+
+    ~call_stats_t() { delete histogram.load(std::memory_order_relaxed); }
+
+    void add(const duration_t &d)
+    {
+        count.store(count.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+        total.store(total.load(std::memory_order_relaxed) + d.count(),
+                    std::memory_order_relaxed);
+        if (!with_histogram) { return; }
+        log_histogram_t *h = histogram.load(std::memory_order_relaxed);
+        if (h == nullptr) {
+            h = new log_histogram_t();
+            histogram.store(h, std::memory_order_release);
+        }
+        h->add(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+    }
+};
+
+/*! Count, sum, min, max and histogram of the values recorded by
+    TRACE_COUNTER or TRACE_GAUGE, written by one thread. The histogram is
+    kept in units of 1 / scale, values below 0 are counted as 0 in it.
+*/
+struct value_stats_t {
+    static constexpr double scale = 1000;
+
+    std::atomic<uint32_t> count;
+    std::atomic<double> sum;
+    std::atomic<double> min;
+    std::atomic<double> max;
+    std::atomic<log_histogram_t *> histogram;
+
+    ~value_stats_t() { delete histogram.load(std::memory_order_relaxed); }
+
+    void add(double v)
+    {
+        const uint32_t n = count.load(std::memory_order_relaxed);
+        if (n == 0 || v < min.load(std::memory_order_relaxed)) {
+            min.store(v, std::memory_order_relaxed);
+        }
+        if (n == 0 || v > max.load(std::memory_order_relaxed)) {
+            max.store(v, std::memory_order_relaxed);
+        }
+        sum.store(sum.load(std::memory_order_relaxed) + v,
+                  std::memory_order_relaxed);
+        log_histogram_t *h = histogram.load(std::memory_order_relaxed);
+        if (h == nullptr) {
+            h = new log_histogram_t();
+            histogram.store(h, std::memory_order_release);
+        }
+        h->add(v > 0 ? static_cast<uint64_t>(v * scale + 0.5) : 0);
+        // last, so that a reader seeing count > 0 sees min and max
+        count.store(n + 1, std::memory_order_release);
+    }
+};
+
+/*! One local_t per thread, registered with the owner so that all of them
+    can be visited from any thread, e.g. to merge them into a report.
+    local() takes no lock after the first call on a thread. Buffers of
+    threads that have exited are kept until the owner is destroyed.
+*/
+template <typename local_t> class per_thread_t
+{
+  public:
+    per_thread_t() : id(next_id()) {}
+
+    per_thread_t(const per_thread_t &) = delete;
+    per_thread_t &operator=(const per_thread_t &) = delete;
+
+    local_t &local()
+    {
+        struct cache_t {
+            uint64_t id = 0;
+            local_t *local = nullptr;
+            std::unordered_map<uint64_t, local_t *> all;
+        };
+        static thread_local cache_t cache;
+        if (cache.id != id) {
+            local_t *&p = cache.all[id];
+            if (p == nullptr) { p = add(); }
+            cache.id = id;
+            cache.local = p;
+        }
+        return *cache.local;
+    }
+
+    template <typename F> void for_each(const F &f) const
+    {
+        std::lock_guard<std::mutex> _(mu);
+        for (const auto &l : locals) { f(*l); }
+    }
+
+  private:
+    const uint64_t id;  // never reused, unlike the address of this
+
+    mutable std::mutex mu;
+    std::vector<std::unique_ptr<local_t>> locals;
+
+    local_t *add()
+    {
+        std::lock_guard<std::mutex> _(mu);
+        locals.emplace_back(new local_t);
+        return locals.back().get();
+    }
+
+    static uint64_t next_id()
+    {
+        static std::atomic<uint64_t> n(1);
+        return n++;
+    }
+};
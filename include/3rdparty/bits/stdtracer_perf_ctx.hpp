@@ -0,0 +1,276 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "stdtracer_base.hpp"
+#include "stdtracer_per_thread.hpp"
+
+/*! A group of hardware counters of the calling thread, read with one
+    syscall. Counters the kernel or the CPU doesn't support (e.g. in a
+    container or a VM) are left out, if none can be opened the group is
+    unavailable and reads return zeros.
+*/
+class perf_counter_group_t
+{
+  public:
+    enum { cycles, instructions, llc_misses, branch_misses, n_counters };
+
+    perf_counter_group_t() : leader(-1), error(0)
+    {
+        const uint64_t configs[n_counters] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+        for (int i = 0; i < n_counters; ++i) {
+            fds[i] = -1;
+            slot[i] = -1;
+        }
+        int n = 0;
+        for (int i = 0; i < n_counters; ++i) {
+            const int fd = open(configs[i], leader);
+            if (fd < 0) {
+                if (i == cycles) { break; }  // no leader, no group
+                continue;
+            }
+            if (leader < 0) { leader = fd; }
+            fds[i] = fd;
+            slot[i] = n++;
+        }
+        if (leader >= 0) {
+            ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+    }
+
+    ~perf_counter_group_t()
+    {
+        for (int fd : fds) {
+            if (fd >= 0) { close(fd); }
+        }
+    }
+
+    perf_counter_group_t(const perf_counter_group_t &) = delete;
+    perf_counter_group_t &operator=(const perf_counter_group_t &) = delete;
+
+    bool available() const { return leader >= 0; }
+
+    bool has(int counter) const { return slot[counter] >= 0; }
+
+    //! errno of the failed perf_event_open, 0 if all counters are open
+    int last_error() const { return error; }
+
+    void read_all(uint64_t (&values)[n_counters]) const
+    {
+        struct {
+            uint64_t nr;
+            uint64_t v[n_counters];
+        } buf;
+        std::memset(values, 0, sizeof(values));
+        if (leader < 0 || ::read(leader, &buf, sizeof(buf)) <= 0) { return; }
+        for (int i = 0; i < n_counters; ++i) {
+            if (slot[i] >= 0 && (uint64_t)slot[i] < buf.nr) {
+                values[i] = buf.v[slot[i]];
+            }
+        }
+    }
+
+  private:
+    int fds[n_counters];
+    int slot[n_counters];  // position in the group read, -1 if not opened
+    int leader;
+    int error;
+
+    int open(uint64_t config, int group_fd)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = group_fd < 0 ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        const int fd =
+            syscall(SYS_perf_event_open, &attr, 0 /* this thread */,
+                    -1 /* any cpu */, group_fd, 0);
+        if (fd < 0) { error = errno; }
+        return fd;
+    }
+};
+
+/*! Reads hardware counters around each scope, and reports IPC, LLC misses
+    and branch misses per call next to the timing, to tell compute bound
+    stages from memory bound ones. Each scope costs two read syscalls, so
+    use it on stages rather than on per-pixel scopes.
+*/
+template <typename clock_t, typename duration_t> class perf_tracer_ctx_t_
+{
+    using counters_t = uint64_t[perf_counter_group_t::n_counters];
+
+  public:
+    explicit perf_tracer_ctx_t_(const std::string &name)
+        : name(name), t0(clock_t::now())
+    {
+    }
+
+    ~perf_tracer_ctx_t_()
+    {
+        if (names.size() > 0) { report(stdout); }
+    }
+
+    void in(const std::string &name)
+    {
+        auto &l = local();
+        l.stack.emplace_back();
+        l.group->read_all(l.stack.back().v);
+    }
+
+    void out(const std::string &name, const duration_t &d)
+    {
+        auto &l = local();
+        counters_t now;
+        l.group->read_all(now);
+        const auto &start = l.stack.back().v;
+
+        auto &s = l.stats.at(names.id(name, l.ids));
+        inc(s.count, 1);
+        inc(s.ns, std::chrono::duration_cast<std::chrono::nanoseconds>(d)
+                      .count());
+        for (int i = 0; i < perf_counter_group_t::n_counters; ++i) {
+            inc(s.counters[i], now[i] - start[i]);
+        }
+        l.stack.pop_back();
+    }
+
+    void report(FILE *fp) const
+    {
+        const auto total = since<double, clock_t>(t0);
+        const auto ns = names.names();
+        std::vector<item_t> list(ns.size());
+        for (uint32_t i = 0; i < ns.size(); ++i) { list[i].name = ns[i]; }
+        bool available = false;
+        bool has[perf_counter_group_t::n_counters] = {false};
+        int error = 0;
+        locals.for_each([&](const local_t &l) {
+            if (l.group->available()) { available = true; }
+            for (int j = 0; j < perf_counter_group_t::n_counters; ++j) {
+                has[j] = has[j] || l.group->has(j);
+            }
+            if (l.group->last_error()) { error = l.group->last_error(); }
+            for (uint32_t i = 0; i < ns.size(); ++i) {
+                const auto *s = l.stats.find(i);
+                if (s == nullptr) { continue; }
+                list[i].count += s->count.load(std::memory_order_relaxed);
+                list[i].ns += s->ns.load(std::memory_order_relaxed);
+                for (int j = 0; j < perf_counter_group_t::n_counters; ++j) {
+                    list[i].counters[j] +=
+                        s->counters[j].load(std::memory_order_relaxed);
+                }
+            }
+        });
+        list.erase(std::remove_if(list.begin(), list.end(),
+                                  [](const item_t &it) { return it.count == 0; }),
+                   list.end());
+        std::sort(list.begin(), list.end(),
+                  [](const item_t &a, const item_t &b) { return a.ns > b.ns; });
+
+        const std::string hr(112, '-');
+        fprintf(fp, "\tperf counters of %s::%s (%fs)\n", "perf_tracer_ctx_t_",
+                name.c_str(), total.count());
+        if (!available) {
+            fprintf(fp, "// perf events unavailable (%s), timing only\n",
+                    strerror(error));
+        } else if (error) {
+            fprintf(fp, "// some perf events unavailable (%s)\n",
+                    strerror(error));
+        }
+        fprintf(fp, "%s\n", hr.c_str());
+        fprintf(fp, "%8s    %16s    %12s    %8s    %14s    %14s    %s\n",
+                "count", "cumulative (s)", "mean (ms)", "IPC", "LLC miss/call",
+                "br miss/call", "call site");
+        fprintf(fp, "%s\n", hr.c_str());
+        using pc = perf_counter_group_t;
+        for (const auto &it : list) {
+            const double t = it.ns * 1e-9;
+            const auto per_call = [&](int j) -> std::string {
+                if (!has[j]) { return "-"; }
+                return format("%.1f", double(it.counters[j]) / it.count);
+            };
+            const std::string ipc =
+                has[pc::cycles] && has[pc::instructions] &&
+                        it.counters[pc::cycles] > 0
+                    ? format("%.2f", double(it.counters[pc::instructions]) /
+                                         it.counters[pc::cycles])
+                    : "-";
+            fprintf(fp, "%8lu    %16f    %12.4f    %8s    %14s    %14s    %s\n",
+                    (unsigned long)it.count, t, 1000 * t / it.count,
+                    ipc.c_str(), per_call(pc::llc_misses).c_str(),
+                    per_call(pc::branch_misses).c_str(), it.name.c_str());
+        }
+    }
+
+  private:
+    const std::string name;
+    const std::chrono::time_point<clock_t> t0;
+
+    struct stats_t {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> ns;
+        std::atomic<uint64_t> counters[perf_counter_group_t::n_counters];
+    };
+
+    struct frame_t {
+        counters_t v;
+    };
+
+    struct local_t {
+        // opened by the thread that uses them, on its first scope
+        const std::unique_ptr<perf_counter_group_t> group{
+            new perf_counter_group_t};
+        std::vector<frame_t> stack;
+        string_registry_t::cache_t ids;
+        slot_array_t<stats_t> stats;
+    };
+
+    struct item_t {
+        std::string name;
+        uint64_t count = 0;
+        uint64_t ns = 0;
+        uint64_t counters[perf_counter_group_t::n_counters] = {0};
+    };
+
+    string_registry_t names;
+    per_thread_t<local_t> locals;
+
+    local_t &local() { return locals.local(); }
+
+    static void inc(std::atomic<uint64_t> &x, uint64_t d)
+    {
+        x.store(x.load(std::memory_order_relaxed) + d,
+                std::memory_order_relaxed);
+    }
+
+    template <typename... Args>
+    static std::string format(const char *fmt, const Args &... args)
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), fmt, args...);
+        return buf;
+    }
+};
@@ -1,7 +1,11 @@
 #pragma once
 #include <chrono>
+#include <initializer_list>
 #include <string>
+#include <tuple>
+#include <type_traits>
 
+#include "stdtracer_alloc_counters.hpp"
 #include "stdtracer_base.hpp"
 
 template <typename ctx_t, typename clock_t = std::chrono::high_resolution_clock>
@@ -22,38 +26,49 @@ class scope_t_
     ctx_t &ctx;
 };
 
-template <typename clock_t,
-          // typename... ctx_t,
-          typename ctx_t_1, typename ctx_t_2>
-class multi_ctx_scope_t_
+// Traces a scope in several contexts, entered in order and left in reverse.
+// Allocations made by the tracer itself are not counted by
+// alloc_tracer_ctx_t_, names are taken as const char * so that the caller
+// doesn't make a std::string either.
+template <typename clock_t, typename... ctx_t>
+class multi_ctx_scope_t_ : private alloc_pause_t
 {
   public:
-    multi_ctx_scope_t_(const std::string &name,
-                       //  ctx_t &... ctxs,
-                       ctx_t_1 &c1, ctx_t_2 &c2)
-        : name(name), t0(clock_t::now()),  // ctxs({ctxs...})
-          c1(c1), c2(c2)
+    multi_ctx_scope_t_(const char *name, ctx_t &... ctxs)
+        : name(name), t0(clock_t::now()), ctxs(ctxs...)
+    {
+        (void)std::initializer_list<int>{(ctxs.in(this->name), 0)...};
+        resume();
+    }
+
+    multi_ctx_scope_t_(const std::string &name, ctx_t &... ctxs)
+        : multi_ctx_scope_t_(name.c_str(), ctxs...)
     {
-        // {ctxs.in(name)...};
-        c1.in(name);
-        c2.in(name);
     }
 
     ~multi_ctx_scope_t_()
     {
         const auto d = since<double, clock_t>(t0);
-        c2.out(name, d);
-        c1.out(name, d);
-        // ctxs.out(name, d);
+        pause();  // until the name is freed, by ~alloc_pause_t
+        out<sizeof...(ctx_t)>(d);
     }
 
   private:
     const std::string name;
     const std::chrono::time_point<clock_t> t0;
-    // ctx_t &ctx;
-    // std::tuple<ctx_t &...> ctxs;
-    ctx_t_1 &c1;
-    ctx_t_2 &c2;
+    std::tuple<ctx_t &...> ctxs;
+
+    template <size_t i, typename duration_t>
+    typename std::enable_if<(i == 0)>::type out(const duration_t &)
+    {
+    }
+
+    template <size_t i, typename duration_t>
+    typename std::enable_if<(i > 0)>::type out(const duration_t &d)
+    {
+        std::get<i - 1>(ctxs).out(name, d);
+        out<i - 1>(d);
+    }
 };
 
 template <typename log_ctx_t> class set_trace_log_t
@@ -65,19 +80,10 @@ template <typename log_ctx_t> class set_trace_log_t
         FILE *fp = reuse  //
                        ? std::fopen(name.c_str(), "a")
                        : std::fopen(name.c_str(), "w");
-        ctx.log_files.push_front(fp);
-        ctx.indent();
-        ctx.logf1(stdout, "start logging to %s", name.c_str());
+        ctx.push_log_file(fp, name);
     }
 
-    ~set_trace_log_t()
-    {
-        ctx.indent();
-        ctx.logf1(stdout, "stop logging to file://%s", name.c_str());
-        FILE *fp = ctx.log_files.front();
-        ctx.log_files.pop_front();
-        std::fclose(fp);
-    }
+    ~set_trace_log_t() { ctx.pop_log_file(name); }
 
   private:
     const std::string name;
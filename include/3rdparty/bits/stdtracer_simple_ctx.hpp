@@ -1,23 +1,26 @@
 #pragma once
 #include <algorithm>
 #include <cstdio>
+#include <functional>
+#include <mutex>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include "stdtracer_base.hpp"
+#include "stdtracer_per_thread.hpp"
 
 template <typename clock_t, typename duration_t> class simple_tracer_ctx_t_
 {
   public:
     explicit simple_tracer_ctx_t_(const std::string &name)
-        : name(name), t0(clock_t::now()), depth(0)
+        : name(name), t0(clock_t::now())
     {
     }
 
     ~simple_tracer_ctx_t_()
     {
-        if (!call_info_map.empty()) {
+        if (names.size() > 0 || counters.size() > 0 || gauges.size() > 0 ||
+            !get_reporters().empty()) {
             constexpr const char *filename = "trace.log";
             fprintf(stderr, "// profile info logged to file://%s\n", filename);
             FILE *fp = fopen(filename, "w");
@@ -27,55 +30,312 @@ template <typename clock_t, typename duration_t> class simple_tracer_ctx_t_
         }
     }
 
-    void in(const std::string &name) { ++depth; }
+    void in(const std::string &name) {}
 
+    // Safe to call from any thread, stats are kept per thread.
     void out(const std::string &name, const duration_t &d)
     {
-        auto &info = call_info_map[name];
-        ++info.first;
-        info.second += d;
+        auto &l = locals.local();
+        l.stats.at(names.id(name, l.ids)).add(d);
+    }
+
+    //! Adds value to a running total, e.g. the number of dropped frames.
+    void counter(const std::string &name, double value)
+    {
+        auto &l = locals.local();
+        l.counters.at(counters.id(name, l.counter_ids)).add(value);
+    }
+
+    //! Records the current value of a quantity, e.g. a queue depth.
+    void gauge(const std::string &name, double value)
+    {
+        auto &l = locals.local();
+        l.gauges.at(gauges.id(name, l.gauge_ids)).add(value);
+    }
+
+    //! Writes a snapshot in the Prometheus text format, see
+    //! metrics_exporter_t. Safe while other threads trace.
+    void export_prometheus(FILE *fp) const
+    {
+        const std::string ctx = "ctx=\"" + escape_label(name) + "\"";
+        fprintf(fp, "# TYPE stdtracer_uptime_seconds gauge\n");
+        fprintf(fp, "stdtracer_uptime_seconds{%s} %f\n", ctx.c_str(),
+                since<double, clock_t>(t0).count());
+
+        // bounds of the histogram buckets, in seconds
+        static const double les[] = {1e-4, 2.5e-4, 5e-4,  1e-3, 2.5e-3,
+                                     5e-3, 1e-2,   2.5e-2, 5e-2, 0.1,
+                                     0.25, 0.5,    1,      2.5,  5};
+        static const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+        const auto scopes = merge();
+        fprintf(fp, "# TYPE stdtracer_scope_duration_seconds histogram\n");
+        for (const auto &it : scopes) {
+            if (it.count == 0) { continue; }
+            const std::string labels =
+                ctx + ",scope=\"" + escape_label(it.name) + "\"";
+            // +Inf and _count must agree, it.count is read separately
+            const uint64_t count = it.histogram.count();
+            for (const double le : les) {
+                fprintf(fp,
+                        "stdtracer_scope_duration_seconds_bucket{%s,le=\"%g\"}"
+                        " %lu\n",
+                        labels.c_str(), le,
+                        (unsigned long)it.histogram.count_le(le * 1e9));
+            }
+            fprintf(fp,
+                    "stdtracer_scope_duration_seconds_bucket{%s,le=\"+Inf\"}"
+                    " %lu\n",
+                    labels.c_str(), (unsigned long)count);
+            fprintf(fp, "stdtracer_scope_duration_seconds_sum{%s} %f\n",
+                    labels.c_str(), it.duration.count());
+            fprintf(fp, "stdtracer_scope_duration_seconds_count{%s} %lu\n",
+                    labels.c_str(), (unsigned long)count);
+        }
+        // since the start, use the histogram for recent quantiles
+        fprintf(fp, "# TYPE stdtracer_scope_latency_seconds gauge\n");
+        for (const auto &it : scopes) {
+            if (it.count == 0) { continue; }
+            for (const double q : quantiles) {
+                fprintf(fp,
+                        "stdtracer_scope_latency_seconds{%s,scope=\"%s\","
+                        "quantile=\"%g\"} %g\n",
+                        ctx.c_str(), escape_label(it.name).c_str(), q,
+                        it.histogram.percentile(q) * 1e-9);
+            }
+        }
 
-        --depth;
+        const auto cs = merge_values(counters, &local_t::counters, true);
+        fprintf(fp, "# TYPE stdtracer_counter_total counter\n");
+        for (const auto &it : cs) {
+            if (it.count == 0) { continue; }
+            fprintf(fp, "stdtracer_counter_total{%s,name=\"%s\"} %.17g\n",
+                    ctx.c_str(), escape_label(it.name).c_str(), it.sum);
+        }
+
+        // rate(sum) / rate(count) gives the recent mean
+        const auto gs = merge_values(gauges, &local_t::gauges, false);
+        const struct {
+            const char *suffix;
+            const char *type;
+            double value_summary_t::*field;
+        } fields[] = {
+            {"sum", "counter", &value_summary_t::sum},
+            {"min", "gauge", &value_summary_t::min},
+            {"max", "gauge", &value_summary_t::max},
+        };
+        fprintf(fp, "# TYPE stdtracer_gauge_count counter\n");
+        for (const auto &it : gs) {
+            if (it.count == 0) { continue; }
+            fprintf(fp, "stdtracer_gauge_count{%s,name=\"%s\"} %u\n",
+                    ctx.c_str(), escape_label(it.name).c_str(), it.count);
+        }
+        for (const auto &f : fields) {
+            fprintf(fp, "# TYPE stdtracer_gauge_%s %s\n", f.suffix, f.type);
+            for (const auto &it : gs) {
+                if (it.count == 0) { continue; }
+                fprintf(fp, "stdtracer_gauge_%s{%s,name=\"%s\"} %.17g\n",
+                        f.suffix, ctx.c_str(), escape_label(it.name).c_str(),
+                        it.*f.field);
+            }
+        }
+    }
+
+    // A reporter appends its own section to the report, e.g. queue stats.
+    using reporter_t = std::function<void(FILE *)>;
+
+    void add_reporter(const reporter_t &r)
+    {
+        std::lock_guard<std::mutex> _(reporters_mu);
+        reporters.push_back(r);
     }
 
   private:
     const std::string name;
     const std::chrono::time_point<clock_t> t0;
 
-    int depth;
+    struct local_t {
+        string_registry_t::cache_t ids;
+        slot_array_t<call_stats_t<duration_t>> stats;
+        string_registry_t::cache_t counter_ids;
+        slot_array_t<value_stats_t> counters;
+        string_registry_t::cache_t gauge_ids;
+        slot_array_t<value_stats_t> gauges;
+    };
+
+    string_registry_t names;
+    string_registry_t counters;
+    string_registry_t gauges;
+    per_thread_t<local_t> locals;
 
-    using call_info_t = std::pair<uint32_t, duration_t>;
-    std::unordered_map<std::string, call_info_t> call_info_map;
+    mutable std::mutex reporters_mu;
+    std::vector<reporter_t> reporters;
+
+    // a copy, so that reporters run without the lock
+    std::vector<reporter_t> get_reporters() const
+    {
+        std::lock_guard<std::mutex> _(reporters_mu);
+        return reporters;
+    }
 
     void report(FILE *fp) const
     {
         const auto total = since<double, clock_t>(t0);
-        using item_t = std::tuple<duration_t, uint32_t, std::string>;
-        std::vector<item_t> list;
-        // for (const auto [name, duration] : total_durations) {
-        for (const auto &it : call_info_map) {
-            const auto name = it.first;
-            const auto call_times = it.second.first;
-            const auto duration = it.second.second;
-            list.push_back(item_t(duration, call_times, name));
+        std::vector<summary_t> list;
+        for (auto &it : merge()) {
+            if (it.count > 0) { list.push_back(std::move(it)); }
         }
-        std::sort(list.rbegin(), list.rend());
+        std::sort(list.begin(), list.end(),
+                  [](const summary_t &a, const summary_t &b) {
+                      return a.duration > b.duration;
+                  });
 
-        const std::string hr(80, '-');
+        const std::string hr(140, '-');
         fprintf(fp, "\tsummary of %s::%s (%fs)\n", "tracer_ctx_t",  //
                 name.c_str(), total.count());
         fprintf(fp, "%s\n", hr.c_str());
-        fprintf(fp, "%8s    %16s    %12s    %12s    %s\n",  //
-                "count", "cumulative (s)", "%", "mean (ms)", "call site");
+        fprintf(fp,
+                "%8s    %16s    %12s    %12s    "
+                "%10s  %10s  %10s  %10s  %10s    %s\n",  //
+                "count", "cumulative (s)", "%", "mean (ms)", "p50 (ms)",
+                "p90 (ms)", "p99 (ms)", "p99.9 (ms)", "max (ms)", "call site");
         fprintf(fp, "%s\n", hr.c_str());
-        // for (const auto &[duration, count, name] : list) {
+        const auto ms = [](uint64_t ns) { return ns / 1e6; };
         for (const auto &it : list) {
-            const auto duration = std::get<0>(it);
-            const auto count = std::get<1>(it);
-            const auto name = std::get<2>(it);
-            fprintf(fp, "%8d    %16f    %12.2f    %12.4f    %s\n",  //
-                    count, duration.count(), duration * 100 / total,
-                    1000 * duration.count() / count, name.c_str());
+            const auto &h = it.histogram;
+            fprintf(fp,
+                    "%8d    %16f    %12.2f    %12.4f    "
+                    "%10.4f  %10.4f  %10.4f  %10.4f  %10.4f    %s\n",  //
+                    it.count, it.duration.count(), it.duration * 100 / total,
+                    1000 * it.duration.count() / it.count,
+                    ms(h.percentile(0.5)), ms(h.percentile(0.9)),
+                    ms(h.percentile(0.99)), ms(h.percentile(0.999)),
+                    ms(h.max()), it.name.c_str());
         }
+
+        report_values(fp);
+        for (const auto &r : get_reporters()) { r(fp); }
+    }
+
+    void report_values(FILE *fp) const
+    {
+        auto list = merge_values(counters, &local_t::counters, true);
+        for (auto &it : merge_values(gauges, &local_t::gauges, false)) {
+            list.push_back(std::move(it));
+        }
+        list.erase(std::remove_if(list.begin(), list.end(),
+                                  [](const value_summary_t &it) {
+                                      return it.count == 0;
+                                  }),
+                   list.end());
+        if (list.empty()) { return; }
+
+        const std::string hr(124, '-');
+        fprintf(fp, "\tvalues of %s::%s\n", "tracer_ctx_t", name.c_str());
+        fprintf(fp, "%s\n", hr.c_str());
+        fprintf(fp,
+                "%8s    %8s    %12s    %10s  %10s  %10s  %10s  %10s  "
+                "%10s    %s\n",  //
+                "kind", "count", "total", "mean", "min", "p50", "p90", "p99",
+                "max", "name");
+        fprintf(fp, "%s\n", hr.c_str());
+        const auto v = [](uint64_t x) { return x / value_stats_t::scale; };
+        for (const auto &it : list) {
+            const auto &h = it.histogram;
+            char total[32] = "-";  // only counters have a total
+            if (it.is_counter) {
+                snprintf(total, sizeof(total), "%.4g", it.sum);
+            }
+            fprintf(fp,
+                    "%8s    %8d    %12s    %10.4g  %10.4g  %10.4g  %10.4g  "
+                    "%10.4g  %10.4g    %s\n",  //
+                    it.is_counter ? "counter" : "gauge", it.count, total,
+                    it.sum / it.count, it.min, v(h.percentile(0.5)),
+                    v(h.percentile(0.9)), v(h.percentile(0.99)), it.max,
+                    it.name.c_str());
+        }
+    }
+
+    struct summary_t {
+        std::string name;
+        uint32_t count = 0;
+        duration_t duration = duration_t::zero();
+        histogram_summary_t histogram;
+    };
+
+    struct value_summary_t {
+        std::string name;
+        bool is_counter = false;
+        uint32_t count = 0;
+        double sum = 0;
+        double min = 0;
+        double max = 0;
+        histogram_summary_t histogram;
+    };
+
+    std::vector<value_summary_t>
+    merge_values(const string_registry_t &registry,
+                 slot_array_t<value_stats_t> local_t::*stats,
+                 bool is_counter) const
+    {
+        const auto ns = registry.names();
+        std::vector<value_summary_t> list(ns.size());
+        for (uint32_t i = 0; i < ns.size(); ++i) {
+            list[i].name = ns[i];
+            list[i].is_counter = is_counter;
+        }
+        locals.for_each([&](const local_t &l) {
+            for (uint32_t i = 0; i < ns.size(); ++i) {
+                const auto *s = (l.*stats).find(i);
+                if (s == nullptr) { continue; }
+                const uint32_t n = s->count.load(std::memory_order_acquire);
+                if (n == 0) { continue; }
+                auto &it = list[i];
+                const double lo = s->min.load(std::memory_order_relaxed);
+                const double hi = s->max.load(std::memory_order_relaxed);
+                it.min = it.count == 0 ? lo : std::min(it.min, lo);
+                it.max = it.count == 0 ? hi : std::max(it.max, hi);
+                it.count += n;
+                it.sum += s->sum.load(std::memory_order_relaxed);
+                const auto *h = s->histogram.load(std::memory_order_acquire);
+                if (h) { it.histogram.merge(*h); }
+            }
+        });
+        return list;
+    }
+
+    static std::string escape_label(const std::string &s)
+    {
+        std::string t;
+        for (const char c : s) {
+            if (c == '\\' || c == '"') {
+                t += '\\';
+                t += c;
+            } else if (c == '\n') {
+                t += "\\n";
+            } else {
+                t += c;
+            }
+        }
+        return t;
+    }
+
+    // sums the stats of all threads
+    std::vector<summary_t> merge() const
+    {
+        const auto ns = names.names();
+        std::vector<summary_t> list(ns.size());
+        for (uint32_t i = 0; i < ns.size(); ++i) { list[i].name = ns[i]; }
+        locals.for_each([&](const local_t &l) {
+            for (uint32_t i = 0; i < ns.size(); ++i) {
+                const auto *s = l.stats.find(i);
+                if (s == nullptr) { continue; }
+                list[i].duration +=
+                    duration_t(s->total.load(std::memory_order_relaxed));
+                list[i].count += s->count.load(std::memory_order_relaxed);
+                const auto *h = s->histogram.load(std::memory_order_acquire);
+                if (h) { list[i].histogram.merge(*h); }
+            }
+        });
+        return list;
     }
 };
@@ -1,94 +1,183 @@
 #pragma once
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <cstdio>
 #include <sstream>
-#include <stack>
 #include <string>
-#include <tuple>
 #include <unordered_map>
 #include <vector>
 
 #include "stdtracer_base.hpp"
+#include "stdtracer_per_thread.hpp"
 
+/*! Aggregates scopes by call chain, e.g. /main/inference/resize.
+
+    Besides the table, the destructor writes the chains in the folded-stack
+    format (one "main;inference;resize <self us>" line per chain), which
+    flamegraph.pl, speedscope or Perfetto render as a flame graph. Self time
+    is the time of a scope minus the time of its nested scopes.
+*/
 template <typename clock_t, typename duration_t> class stack_tracer_ctx_t_
 {
   public:
-    stack_tracer_ctx_t_(const std::string &name)
-        : name(name), t0(clock_t::now()), call_stack_str("")
+    stack_tracer_ctx_t_(const std::string &name,
+                        const std::string &folded_filename = "trace.folded")
+        : name(name), folded_filename(folded_filename), t0(clock_t::now())
     {
     }
 
     ~stack_tracer_ctx_t_()
     {
-        if (!call_info_map.empty()) { report(stdout); }
+        if (call_stacks.size() > 0) {
+            report(stdout);
+            if (!folded_filename.empty()) {
+                fprintf(stderr, "// folded stacks logged to file://%s\n",
+                        folded_filename.c_str());
+                FILE *fp = fopen(folded_filename.c_str(), "w");
+                if (fp) {
+                    dump_folded(fp);
+                    fclose(fp);
+                }
+            }
+        }
     }
 
+    // Each thread has its own call stack and stats.
     void in(const std::string &name)
     {
-        const int idx = get_idx(name);
-        call_stack_str += "/" + std::to_string(idx);
+        auto &l = locals.local();
+        const uint32_t name_id = names.id(name, l.name_ids);
+        const uint32_t parent = l.stack.empty() ? root : l.stack.back().id;
+        const uint64_t edge = (uint64_t)parent << 32 | name_id;
+        auto pos = l.edges.find(edge);
+        if (pos == l.edges.end()) {  // first time on this thread
+            std::string call_stack_str;
+            for (const auto &f : l.stack) {
+                call_stack_str += "/" + std::to_string(f.name_id);
+            }
+            call_stack_str += "/" + std::to_string(name_id);
+            pos = l.edges.emplace(edge, call_stacks.id(call_stack_str)).first;
+        }
+        l.stack.push_back(frame_t{pos->second, name_id, duration_t::zero()});
     }
 
     void out(const std::string &name, const duration_t &d)
     {
-        auto &info = call_info_map[call_stack_str];
-        ++info.first;
-        info.second += d;
+        auto &l = locals.local();
+        const frame_t f = l.stack.back();
+        l.stack.pop_back();
+        if (!l.stack.empty()) { l.stack.back().children += d; }
 
-        call_stack_str.erase(call_stack_str.rfind('/'));
+        auto &s = l.stats.at(f.id);
+        s.total.add(d);
+        s.self.store(s.self.load(std::memory_order_relaxed) +
+                         (d - f.children).count(),
+                     std::memory_order_relaxed);
     }
 
-    void report(FILE *fp)
+    void report(FILE *fp) const
     {
         const auto total = since<double>(t0);
-        using item_t = std::tuple<duration_t, uint32_t, std::string>;
-        std::vector<item_t> list;
-        // for (const auto [name, duration] : total_durations) {
-        for (const auto &it : call_info_map) {
-            const auto name = it.first;
-            const auto info = it.second;
-            list.push_back(item_t(info.second, info.first, name));
-        }
-        std::sort(list.rbegin(), list.rend());
+        const auto ns = names.names();
+        const auto list = merge();
 
-        const std::string hr(80, '-');
+        const std::string hr(96, '-');
         fprintf(fp, "\tinvoke tree of %s::%s (%fs)\n", "stack_tracer_ctx_t_",
                 name.c_str(), total.count());
         fprintf(fp, "%s\n", hr.c_str());
-        fprintf(fp, "%8s    %16s    %12s    %12s    %s\n",  //
-                "count", "cumulative (s)", "%", "mean (ms)", "call chain");
+        fprintf(fp, "%8s    %16s    %12s    %12s    %12s    %s\n",  //
+                "count", "cumulative (s)", "%", "self (s)", "mean (ms)",
+                "call chain");
         fprintf(fp, "%s\n", hr.c_str());
-        // for (const auto &[duration, count, name] : list) {
         for (const auto &it : list) {
-            const auto duration = std::get<0>(it);
-            const auto count = std::get<1>(it);
-            const auto name = decode_call_stack_str(std::get<2>(it));
-            fprintf(fp, "%8d    %16f    %12.2f    %12.4f    %s\n",  //
-                    count, duration.count(), duration * 100 / total,
-                    1000 * duration.count() / count, name.c_str());
+            const auto name = decode_call_stack_str(it.call_stack, ns, "/");
+            fprintf(fp, "%8d    %16f    %12.2f    %12f    %12.4f    %s\n",  //
+                    it.count, it.total.count(), it.total * 100 / total,
+                    it.self.count(), 1000 * it.total.count() / it.count,
+                    name.c_str());
+        }
+    }
+
+    //! Writes one "a;b;c <self time in us>" line per call chain.
+    void dump_folded(FILE *fp) const
+    {
+        const auto ns = names.names();
+        for (const auto &it : merge()) {
+            const double us =
+                std::chrono::duration<double, std::micro>(it.self).count();
+            fprintf(fp, "%s %.0f\n",
+                    decode_call_stack_str(it.call_stack, ns, ";").c_str(),
+                    std::max(us, 0.0));
         }
     }
 
   private:
     const std::string name;
+    const std::string folded_filename;
     const std::chrono::time_point<clock_t> t0;
 
-    std::string call_stack_str;
+    static constexpr uint32_t root = ~(uint32_t)0;
+
+    struct frame_t {
+        uint32_t id;  // of the call stack
+        uint32_t name_id;
+        duration_t children;
+    };
+
+    struct stats_t {
+        call_stats_t<duration_t, false> total;  // the report has no percentiles
+        std::atomic<typename duration_t::rep> self;
+    };
 
-    std::unordered_map<std::string, int> index;
-    std::vector<std::string> names;
+    struct local_t {
+        std::vector<frame_t> stack;
+        // (parent call stack, name) -> call stack
+        std::unordered_map<uint64_t, uint32_t> edges;
+        string_registry_t::cache_t name_ids;
+        slot_array_t<stats_t> stats;
+    };
 
-    using call_info_t = std::pair<uint32_t, duration_t>;
-    std::unordered_map<std::string, call_info_t> call_info_map;
+    struct item_t {
+        std::string call_stack;
+        uint32_t count = 0;
+        duration_t total = duration_t::zero();
+        duration_t self = duration_t::zero();
+    };
 
-    int get_idx(const std::string &name)
+    string_registry_t names;
+    string_registry_t call_stacks;
+    per_thread_t<local_t> locals;
+
+    // sorted by total time
+    std::vector<item_t> merge() const
     {
-        const auto pos = index.find(name);
-        if (pos != index.end()) { return pos->second; }
-        const int idx = names.size();
-        names.push_back(name);
-        index[name] = idx;
-        return idx;
+        const auto keys = call_stacks.names();
+        std::vector<item_t> list(keys.size());
+        for (uint32_t i = 0; i < keys.size(); ++i) {
+            list[i].call_stack = keys[i];
+        }
+        locals.for_each([&](const local_t &l) {
+            for (uint32_t i = 0; i < keys.size(); ++i) {
+                const auto *s = l.stats.find(i);
+                if (s == nullptr) { continue; }
+                list[i].count +=
+                    s->total.count.load(std::memory_order_relaxed);
+                list[i].total +=
+                    duration_t(s->total.total.load(std::memory_order_relaxed));
+                list[i].self +=
+                    duration_t(s->self.load(std::memory_order_relaxed));
+            }
+        });
+        list.erase(std::remove_if(list.begin(), list.end(),
+                                  [](const item_t &it) { return it.count == 0; }),
+                   list.end());
+        std::sort(list.begin(), list.end(),
+                  [](const item_t &a, const item_t &b) {
+                      return a.total > b.total;
+                  });
+        return list;
     }
 
     static std::vector<std::string> split(const std::string &text,
@@ -103,13 +192,24 @@ template <typename clock_t, typename duration_t> class stack_tracer_ctx_t_
         return lines;
     }
 
-    std::string decode_call_stack_str(const std::string &call_ss)
+    static std::string
+    decode_call_stack_str(const std::string &call_ss,
+                          const std::vector<std::string> &names,
+                          const char *sep)
     {
         std::string ss;
         for (const auto &s : split(call_ss, '/')) {
             const int idx = std::stoi(s);
-            ss += "/" + names[idx];
+            if (!ss.empty() || sep[0] == '/') { ss += sep; }
+            std::string name = names[idx];
+            if (sep[0] == ';') {  // frames can't contain the separator
+                std::replace(name.begin(), name.end(), ';', ':');
+            }
+            ss += name;
         }
         return ss;
     }
 };
+
+template <typename clock_t, typename duration_t>
+constexpr uint32_t stack_tracer_ctx_t_<clock_t, duration_t>::root;
@@ -0,0 +1,182 @@
+#pragma once
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+/*! Turns tracing on and off at runtime.
+
+    off     : scopes cost a load and a branch
+    on      : every scope is traced
+    sampled : only 1 out of sample_rate frames is traced, a frame starts at
+              each sample() on the thread that runs it. Frames are counted
+              per thread. Threads that work on frames produced by another
+              thread should join_sample() the decision carried with the
+              frame, so that a sampled frame is traced end to end.
+
+    The initial mode is read from STDTRACER_MODE (off, on, sampled, default
+    off) and STDTRACER_SAMPLE_RATE (default 100). After
+    install_signal_handlers(), SIGUSR1 switches to on and SIGUSR2 back to
+    the initial mode, e.g. to get full detail during an incident.
+    Whatever the mode, contexts only report what was traced, except that
+    counters (trace_counter) are recorded in every frame unless off.
+*/
+class trace_switch_t
+{
+  public:
+    enum mode_t { off = 0, sampled = 1, on = 2 };
+
+    trace_switch_t()
+        : initial_mode(parse_mode(std::getenv("STDTRACER_MODE"))),
+          mode_(initial_mode), sample_rate_(parse_rate(
+                                   std::getenv("STDTRACER_SAMPLE_RATE")))
+    {
+    }
+
+    mode_t mode() const { return (mode_t)mode_.load(std::memory_order_relaxed); }
+
+    void set_mode(mode_t m) { mode_.store(m, std::memory_order_relaxed); }
+
+    void reset_mode() { set_mode(initial_mode); }
+
+    uint32_t sample_rate() const
+    {
+        return sample_rate_.load(std::memory_order_relaxed);
+    }
+
+    void set_sample_rate(uint32_t n)
+    {
+        sample_rate_.store(n > 0 ? n : 1, std::memory_order_relaxed);
+    }
+
+    //! Starts a new frame on this thread, and decides if it is sampled.
+    bool sample()
+    {
+        static thread_local uint64_t frames = 0;
+        return in_sample() = frames++ % sample_rate() == 0;
+    }
+
+    //! If the current frame of this thread is sampled.
+    bool sampled_frame() const { return in_sample(); }
+
+    //! Continues on this thread a frame sampled (or not) by another thread.
+    void join_sample(bool sampled) { in_sample() = sampled; }
+
+    //! If scopes on this thread should be traced now.
+    bool enabled() const
+    {
+        switch (mode()) {
+        case on:
+            return true;
+        case sampled:
+            return in_sample();
+        default:
+            return false;
+        }
+    }
+
+    void install_signal_handlers(int on_signal = SIGUSR1,
+                                 int reset_signal = SIGUSR2);
+
+  private:
+    const mode_t initial_mode;
+    std::atomic<int> mode_;
+    std::atomic<uint32_t> sample_rate_;
+
+    static bool &in_sample()
+    {
+        static thread_local bool s = false;
+        return s;
+    }
+
+    static mode_t parse_mode(const char *s)
+    {
+        if (s == nullptr) { return off; }
+        if (std::strcmp(s, "on") == 0) { return on; }
+        if (std::strcmp(s, "sampled") == 0) { return sampled; }
+        return off;
+    }
+
+    static uint32_t parse_rate(const char *s)
+    {
+        const long n = s ? std::atol(s) : 0;
+        return n > 0 ? n : 100;
+    }
+};
+
+inline trace_switch_t &default_trace_switch()
+{
+    static trace_switch_t s;
+    return s;
+}
+
+inline void trace_switch_t::install_signal_handlers(int on_signal,
+                                                    int reset_signal)
+{
+    // only lock-free atomics are touched in the handler
+    static std::atomic<trace_switch_t *> target(nullptr);
+    static std::atomic<int> on_sig(0);
+    target = this;
+    on_sig = on_signal;
+    const auto handler = [](int sig) {
+        trace_switch_t *s = target.load();
+        if (sig == on_sig.load()) {
+            s->set_mode(on);
+        } else {
+            s->reset_mode();
+        }
+    };
+    std::signal(on_signal, handler);
+    std::signal(reset_signal, handler);
+}
+
+/*! Wraps a scope type, the scope is only created if tracing is enabled for
+    the current thread when the wrapper is created.
+*/
+template <typename scope_t> class switched_scope_t
+{
+  public:
+    template <typename... Args>
+    switched_scope_t(Args &&... args) : active(default_trace_switch().enabled())
+    {
+        if (active) { new (&storage) scope_t(std::forward<Args>(args)...); }
+    }
+
+    ~switched_scope_t()
+    {
+        if (active) { reinterpret_cast<scope_t *>(&storage)->~scope_t(); }
+    }
+
+    switched_scope_t(const switched_scope_t &) = delete;
+    switched_scope_t &operator=(const switched_scope_t &) = delete;
+
+  private:
+    const bool active;
+    typename std::aligned_storage<sizeof(scope_t), alignof(scope_t)>::type
+        storage;
+};
+
+/*! Records a counter increment in ctx, unless tracing is off.
+    Counters are not sampled, so that their totals stay exact in sampled
+    mode, whatever the thread.
+*/
+template <typename ctx_t>
+void trace_counter(ctx_t &ctx, const std::string &name, double value)
+{
+    if (default_trace_switch().mode() != trace_switch_t::off) {
+        ctx.counter(name, value);
+    }
+}
+
+//! Records a gauge value in ctx, if tracing is enabled for this thread,
+//! gauges are observations so they are sampled like scopes.
+template <typename ctx_t>
+void trace_gauge(ctx_t &ctx, const std::string &name, double value)
+{
+    if (default_trace_switch().enabled()) { ctx.gauge(name, value); }
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <ratio>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Raw timestamp counter, falls back to steady_clock in ns on other targets.
+inline uint64_t read_tsc()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+/*! A steady clock on top of the TSC, calibrated once against steady_clock.
+    Assumes an invariant TSC (constant_tsc, nonstop_tsc), which holds for
+    any x86 CPU of the last decade.
+*/
+struct tsc_clock {
+    using rep = int64_t;
+    using period = std::nano;
+    using duration = std::chrono::nanoseconds;
+    using time_point = std::chrono::time_point<tsc_clock>;
+
+    static constexpr bool is_steady = true;
+
+    static time_point now() { return time_point(duration(to_ns(read_tsc()))); }
+
+    static int64_t to_ns(uint64_t ticks) { return ticks * ns_per_tick(); }
+
+    static double ns_per_tick()
+    {
+        static const double r = calibrate();
+        return r;
+    }
+
+  private:
+    static double calibrate()
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        using clock = std::chrono::steady_clock;
+        const auto t0 = clock::now();
+        const uint64_t c0 = read_tsc();
+        auto t1 = t0;
+        while (t1 - t0 < std::chrono::milliseconds(10)) { t1 = clock::now(); }
+        const uint64_t c1 = read_tsc();
+        const double ns =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                .count();
+        return ns / (c1 - c0);
+#else
+        return 1;
+#endif
+    }
+};
@@ -1,4 +1,6 @@
 #pragma once
+#include <bits/std_half.hpp>
+#include <bits/std_strided_tensor.hpp>
 #include <bits/std_tensor.hpp>
 
 namespace ttl
@@ -12,6 +14,15 @@ using tensor_ref = internal::basic_tensor_ref<R, r>;
 template <typename R, internal::rank_t r>
 using tensor_view = internal::basic_tensor_view<R, r>;
 
+// a tensor whose memory is reused through a tensor_pool
+template <typename R, internal::rank_t r>
+using pooled_tensor = internal::basic_tensor<R, r, internal::basic_shape<r>,
+                                             internal::pooled_allocator<R>>;
+
+using internal::aligned_allocator;
+using internal::pooled_allocator;
+using internal::tensor_pool;
+
 // Don't be confused with std::vector
 template <typename R> using vector = tensor<R, 1>;
 template <typename R> using vector_ref = tensor_ref<R, 1>;
@@ -20,4 +31,19 @@ template <typename R> using vector_view = tensor_view<R, 1>;
 template <typename R> using matrix = tensor<R, 2>;
 template <typename R> using matrix_ref = tensor_ref<R, 2>;
 template <typename R> using matrix_view = tensor_view<R, 2>;
+
+// non-contiguous views, see ttl::strided
+template <typename R, internal::rank_t r>
+using strided_tensor_ref = internal::basic_strided_tensor_ref<R, r>;
+
+template <typename R, internal::rank_t r>
+using strided_tensor_view = internal::basic_strided_tensor_ref<const R, r>;
+
+using internal::strided;
+
+// float16 storage, see ttl::cast for bulk conversion
+using internal::half;
+using internal::cast;
+using internal::float_to_half;
+using internal::half_to_float;
 }  // namespace ttl
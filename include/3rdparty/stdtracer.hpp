@@ -1,12 +1,21 @@
 #pragma once
 
 // trace contexts
+#include <bits/stdtracer_alloc_ctx.hpp>
+#include <bits/stdtracer_async_log_ctx.hpp>
+#include <bits/stdtracer_chrome_ctx.hpp>
+#include <bits/stdtracer_fast_ctx.hpp>
 #include <bits/stdtracer_log_ctx.hpp>
+#include <bits/stdtracer_perf_ctx.hpp>
 #include <bits/stdtracer_simple_ctx.hpp>
 #include <bits/stdtracer_stack_ctx.hpp>
 
+// exporters
+#include <bits/stdtracer_exporter.hpp>
+
 // trace scopes
 #include <bits/stdtracer_scope.hpp>
+#include <bits/stdtracer_switch.hpp>
 
 using default_clock_t = std::chrono::high_resolution_clock;
 using default_duration_t = std::chrono::duration<double>;
@@ -14,12 +23,28 @@ using default_duration_t = std::chrono::duration<double>;
 using stack_tracer_ctx_t =
     stack_tracer_ctx_t_<default_clock_t, default_duration_t>;
 
+using alloc_tracer_ctx_t =
+    alloc_tracer_ctx_t_<default_clock_t, default_duration_t>;
+
+using chrome_tracer_ctx_t =
+    chrome_tracer_ctx_t_<default_clock_t, default_duration_t>;
+
+using async_log_tracer_ctx_t =
+    async_log_tracer_ctx_t_<default_clock_t, default_duration_t>;
+
 using log_tracer_ctx_t = log_tracer_ctx_t_<default_clock_t, default_duration_t>;
 
+using perf_tracer_ctx_t =
+    perf_tracer_ctx_t_<default_clock_t, default_duration_t>;
+
 using simple_tracer_ctx_t =
     simple_tracer_ctx_t_<default_clock_t, default_duration_t>;
 
 using simple_tracer_t = scope_t_<simple_tracer_ctx_t>;
 
+using simple_metrics_exporter_t = metrics_exporter_t<simple_tracer_ctx_t>;
+
+using fast_tracer_t = fast_scope_t<fast_tracer_ctx_t>;
+
 using multi_tracer_t =
     multi_ctx_scope_t_<default_clock_t, simple_tracer_ctx_t, log_tracer_ctx_t>;
@@ -1,45 +1,238 @@
 #pragma once
+#include <algorithm>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
 #include <mutex>
-#include <queue>
+#include <string>
+#include <vector>
 
-// FIXME: double check
-template <typename T> class channel
+#include "channel_stats.hpp"
+
+// What put does when the channel is full.
+enum class overflow_policy {
+    block,        // wait until a consumer makes room
+    drop_oldest,  // discard the oldest item to make room
+    keep_latest,  // discard everything queued, only the latest item is kept
+};
+
+// A bounded multi-producer/multi-consumer channel.
+// Producers wait on not_full and consumers wait on not_empty, so a put never
+// wakes up another producer and a get never wakes up another consumer.
+//
+// After close(), put fails and consumers keep receiving the queued items
+// until the channel is drained.
+//
+// stats_t records queue depth and wait time under mu, see channel_stats.hpp.
+template <typename T, typename stats_t = default_channel_stats_t> class channel
 {
   public:
-    channel(int cap) : cap(cap) {}
+    channel(int cap, overflow_policy policy = overflow_policy::block,
+            const std::string &name = "channel")
+        : cap(cap), policy(policy), buffer(cap), head(0), size(0),
+          dropped_(0), closed(false), stats(name, cap, mu)
+    {
+    }
 
+    // Blocks until an item is available, returns T() if the channel is
+    // closed and drained.
     T get()
     {
-        // std::lock_guard<std::mutex> _(mu);
         std::unique_lock<std::mutex> lk(mu);
-        cv.wait(lk, [&]() { return buffer.size() > 0; });
+        wait_not_empty(lk);
 
-        const T x = buffer.front();
-        buffer.pop();
+        T x = T();
+        take(lk, x);
+        return x;
+    }
 
-        // lk.unlock();
-        cv.notify_one();
+    bool try_get(T &x)
+    {
+        std::unique_lock<std::mutex> lk(mu);
+        return take(lk, x);
+    }
 
-        return x;
+    // Returns false on timeout or if the channel is closed and drained.
+    template <typename Rep, typename Period>
+    bool get_for(T &x, const std::chrono::duration<Rep, Period> &timeout)
+    {
+        std::unique_lock<std::mutex> lk(mu);
+        const auto ready = [&]() { return size > 0 || closed; };
+        stats.consumer_wait(
+            ready, [&]() { return not_empty.wait_for(lk, timeout, ready); });
+        return take(lk, x);
+    }
+
+    // Blocks until at least one item is available, then moves up to max_n
+    // items into out within one critical section. Returns the number of items,
+    // which is 0 only if the channel is closed and drained.
+    int get_batch(std::vector<T> &out, int max_n)
+    {
+        std::unique_lock<std::mutex> lk(mu);
+        wait_not_empty(lk);
+        return take_batch(lk, out, max_n);
+    }
+
+    // Waits until max_n items (or a full channel, if max_n > cap) are
+    // available or the timeout expires, then moves whatever is available (up
+    // to max_n) into out, so a partial batch is flushed on deadline.
+    template <typename Rep, typename Period>
+    int get_batch_for(std::vector<T> &out, int max_n,
+                      const std::chrono::duration<Rep, Period> &timeout)
+    {
+        std::unique_lock<std::mutex> lk(mu);
+        // a blocked producer can't add more than cap
+        const size_t n =
+            std::min(static_cast<size_t>(std::max(max_n, 0)), cap);
+        const auto ready = [&]() { return size >= n || closed; };
+        stats.consumer_wait(
+            ready, [&]() { return not_empty.wait_for(lk, timeout, ready); });
+        return take_batch(lk, out, max_n);
     }
 
-    void put(T x)
+    // Returns false if the channel is closed.
+    bool put(T x)
     {
-        // std::lock_guard<std::mutex> _(mu);
         std::unique_lock<std::mutex> lk(mu);
-        cv.wait(lk, [&]() { return buffer.size() < cap; });
-        buffer.push(x);
+        if (policy == overflow_policy::block) {
+            const auto ready = [&]() { return size < cap || closed; };
+            stats.producer_wait(ready, [&]() {
+                not_full.wait(lk, ready);
+                return true;
+            });
+        }
+        return push(lk, std::move(x));
+    }
+
+    // Returns false on timeout or if the channel is closed.
+    template <typename Rep, typename Period>
+    bool put_for(T x, const std::chrono::duration<Rep, Period> &timeout)
+    {
+        std::unique_lock<std::mutex> lk(mu);
+        const auto ready = [&]() { return size < cap || closed; };
+        if (policy == overflow_policy::block &&
+            !stats.producer_wait(ready, [&]() {
+                return not_full.wait_for(lk, timeout, ready);
+            })) {
+            return false;
+        }
+        return push(lk, std::move(x));
+    }
+
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> _(mu);
+            closed = true;
+        }
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+    // true if the channel is closed and all items have been consumed
+    bool drained()
+    {
+        std::lock_guard<std::mutex> _(mu);
+        return closed && size == 0;
+    }
 
-        // lk.unlock();
-        cv.notify_one();
+    // number of items discarded by drop_oldest or keep_latest
+    size_t dropped()
+    {
+        std::lock_guard<std::mutex> _(mu);
+        return dropped_;
     }
 
   private:
-    const int cap;
+    const size_t cap;
+    const overflow_policy policy;
 
     std::mutex mu;
-    std::queue<T> buffer;
+    std::vector<T> buffer;  // ring of cap slots
+    size_t head;
+    size_t size;
+    size_t dropped_;
+    bool closed;
+
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+
+    stats_t stats;
+
+    void wait_not_empty(std::unique_lock<std::mutex> &lk)
+    {
+        const auto ready = [&]() { return size > 0 || closed; };
+        stats.consumer_wait(ready, [&]() {
+            not_empty.wait(lk, ready);
+            return true;
+        });
+    }
+
+    T pop()
+    {
+        T x = std::move(buffer[head]);
+        head = (head + 1) % cap;
+        --size;
+        return x;
+    }
+
+    void drop(size_t n)
+    {
+        for (size_t i = 0; i < n; ++i) { pop(); }
+        dropped_ += n;
+        stats.on_drop(n);
+    }
 
-    std::condition_variable cv;
+    bool take(std::unique_lock<std::mutex> &lk, T &x)
+    {
+        if (size == 0) { return false; }
+        stats.on_get(size, 1);
+        x = pop();
+
+        lk.unlock();
+        not_full.notify_one();
+
+        return true;
+    }
+
+    int take_batch(std::unique_lock<std::mutex> &lk, std::vector<T> &out,
+                   int max_n)
+    {
+        const int n = std::min<int>(size, max_n);
+        if (n > 0) { stats.on_get(size, n); }
+        for (int i = 0; i < n; ++i) { out.push_back(pop()); }
+
+        lk.unlock();
+        if (n > 1) {
+            not_full.notify_all();
+        } else if (n == 1) {
+            not_full.notify_one();
+        }
+
+        return n;
+    }
+
+    bool push(std::unique_lock<std::mutex> &lk, T x)
+    {
+        if (closed) { return false; }
+        stats.on_put(size);
+        switch (policy) {
+        case overflow_policy::block:
+            break;
+        case overflow_policy::drop_oldest:
+            if (size == cap) { drop(1); }
+            break;
+        case overflow_policy::keep_latest:
+            drop(size);
+            break;
+        }
+
+        buffer[(head + size) % cap] = std::move(x);
+        ++size;
+
+        lk.unlock();
+        not_empty.notify_one();
+
+        return true;
+    }
 };
@@ -0,0 +1,263 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Instrumentation hooks of channel<T>.
+// All hooks are called with the channel lock, which is passed to the
+// constructor, held. The wait hooks get the predicate the channel waits for,
+// and the wait itself, which they only need to call (and time) if the
+// predicate is false.
+
+// Does nothing, the default when ENABLE_TRACE is not defined.
+struct no_channel_stats_t {
+    no_channel_stats_t(const std::string & /* name */, int /* cap */,
+                       std::mutex & /* lock */)
+    {
+    }
+
+    void on_put(size_t /* occupancy */) {}
+
+    void on_get(size_t /* occupancy */, size_t /* n */) {}
+
+    void on_drop(size_t /* n */) {}
+
+    template <typename P, typename F>
+    bool producer_wait(const P & /* ready */, const F &wait)
+    {
+        return wait();
+    }
+
+    template <typename P, typename F>
+    bool consumer_wait(const P & /* ready */, const F &wait)
+    {
+        return wait();
+    }
+};
+
+// Records occupancy, blocked time and throughput of a channel.
+// The stats of all channels are written by report_channel_stats(), e.g. at
+// the end of trace.log with ADD_TRACE_REPORTER(report_channel_stats).
+// Live channels are reported one by one, the stats of destroyed channels are
+// summed up by name and capacity.
+class channel_stats_t
+{
+    using clock_t = std::chrono::steady_clock;
+    using duration_t = std::chrono::duration<double>;
+
+    struct data_t {
+        std::string name;
+        int cap;
+        int channels;         // destroyed channels summed up in this
+        duration_t lifetime;  // summed over channels
+
+        uint64_t n_put;
+        uint64_t n_get;
+        uint64_t n_dropped;
+        duration_t producer_blocked;
+        duration_t consumer_blocked;
+
+        // occupancy seen by put, in buckets of 0, 1, 2-3, 4-7, ...
+        std::vector<uint64_t> occupancy;
+
+        data_t(const std::string &name, int cap)
+            : name(name), cap(cap), channels(0), lifetime(0), n_put(0),
+              n_get(0), n_dropped(0), producer_blocked(0),
+              consumer_blocked(0), occupancy(bucket(cap) + 1)
+        {
+        }
+
+        void merge(const data_t &d)
+        {
+            channels += d.channels;
+            lifetime += d.lifetime;
+            n_put += d.n_put;
+            n_get += d.n_get;
+            n_dropped += d.n_dropped;
+            producer_blocked += d.producer_blocked;
+            consumer_blocked += d.consumer_blocked;
+            for (size_t i = 0; i < occupancy.size(); ++i) {
+                occupancy[i] += d.occupancy[i];
+            }
+        }
+
+        void report(FILE *fp) const
+        {
+            const std::string hr(80, '-');
+            if (channels > 0) {
+                fprintf(fp,
+                        "\tchannel stats of %s (cap: %d, %d destroyed "
+                        "channels, %fs)\n",
+                        name.c_str(), cap, channels, lifetime.count());
+            } else {
+                fprintf(fp, "\tchannel stats of %s (cap: %d, %fs)\n",
+                        name.c_str(), cap, lifetime.count());
+            }
+            fprintf(fp, "%s\n", hr.c_str());
+            fprintf(fp, "%10s    %10s    %10s    %10s    %14s    %14s\n",  //
+                    "put", "get", "dropped", "get/s", "put blocked (s)",
+                    "get blocked (s)");
+            fprintf(fp, "%s\n", hr.c_str());
+            fprintf(fp, "%10lu    %10lu    %10lu    %10.2f    %14f    %14f\n",
+                    (unsigned long)n_put, (unsigned long)n_get,
+                    (unsigned long)n_dropped, n_get / lifetime.count(),
+                    producer_blocked.count(), consumer_blocked.count());
+
+            fprintf(fp, "occupancy:");
+            for (size_t i = 0; i < occupancy.size(); ++i) {
+                const int lo = i == 0 ? 0 : 1 << (i - 1);
+                const int hi = i == 0 ? 0 : (1 << i) - 1;
+                const double p = n_put ? occupancy[i] * 100.0 / n_put : 0;
+                if (lo == hi) {
+                    fprintf(fp, " [%d] %.2f%%", lo, p);
+                } else {
+                    fprintf(fp, " [%d-%d] %.2f%%", lo, hi, p);
+                }
+            }
+            fprintf(fp, "\n");
+        }
+    };
+
+    std::mutex &lock;  // of the channel, guards data
+    const clock_t::time_point t0;
+    data_t data;
+
+    static size_t bucket(size_t n)
+    {
+        size_t b = 0;
+        for (; n; n >>= 1) { ++b; }
+        return b;
+    }
+
+    template <typename P, typename F>
+    static bool timed(const P &ready, const F &wait, duration_t &d)
+    {
+        if (ready()) { return true; }  // no wait, nothing to time
+        const auto t0 = clock_t::now();
+        const bool ok = wait();
+        d += clock_t::now() - t0;
+        return ok;
+    }
+
+    // must be called with the channel lock held
+    data_t snapshot() const
+    {
+        data_t d = data;
+        d.lifetime = clock_t::now() - t0;
+        return d;
+    }
+
+  public:
+    channel_stats_t(const std::string &name, int cap, std::mutex &lock)
+        : lock(lock), t0(clock_t::now()), data(name, cap)
+    {
+        registry().add(this);
+    }
+
+    ~channel_stats_t() { registry().remove(this); }
+
+    channel_stats_t(const channel_stats_t &) = delete;
+    channel_stats_t &operator=(const channel_stats_t &) = delete;
+
+    void on_put(size_t occupancy)
+    {
+        ++data.n_put;
+        ++data.occupancy[bucket(occupancy)];
+    }
+
+    void on_get(size_t /* occupancy */, size_t n) { data.n_get += n; }
+
+    void on_drop(size_t n) { data.n_dropped += n; }
+
+    template <typename P, typename F>
+    bool producer_wait(const P &ready, const F &wait)
+    {
+        return timed(ready, wait, data.producer_blocked);
+    }
+
+    template <typename P, typename F>
+    bool consumer_wait(const P &ready, const F &wait)
+    {
+        return timed(ready, wait, data.consumer_blocked);
+    }
+
+    // must not be called with the channel lock held
+    void report(FILE *fp) const
+    {
+        std::unique_lock<std::mutex> lk(lock);
+        const data_t d = snapshot();
+        lk.unlock();
+        d.report(fp);
+    }
+
+    // Reports the stats of all live and destroyed channels.
+    static void report_all(FILE *fp) { registry().report(fp); }
+
+  private:
+    // Lock order: the registry, then a channel.
+    class registry_t
+    {
+      public:
+        void add(channel_stats_t *s)
+        {
+            std::lock_guard<std::mutex> _(mu);
+            live.push_back(s);
+        }
+
+        // called without the channel lock, before the lock is destroyed
+        void remove(channel_stats_t *s)
+        {
+            std::lock_guard<std::mutex> _(mu);
+            live.erase(std::find(live.begin(), live.end(), s));
+            data_t d = s->snapshot();  // nobody else uses the channel now
+            d.channels = 1;
+            for (auto &it : destroyed) {
+                if (it.name == d.name && it.cap == d.cap) {
+                    it.merge(d);
+                    return;
+                }
+            }
+            destroyed.push_back(std::move(d));
+        }
+
+        void report(FILE *fp)
+        {
+            std::vector<data_t> list;
+            {
+                std::lock_guard<std::mutex> _(mu);
+                for (const auto *s : live) {
+                    std::lock_guard<std::mutex> l(s->lock);
+                    list.push_back(s->snapshot());
+                }
+                list.insert(list.end(), destroyed.begin(), destroyed.end());
+            }
+            for (const auto &d : list) { d.report(fp); }
+        }
+
+      private:
+        std::mutex mu;
+        std::vector<channel_stats_t *> live;
+        std::vector<data_t> destroyed;
+    };
+
+    // Never destroyed, so that channels can be created and reported during
+    // static initialization and destruction.
+    static registry_t &registry()
+    {
+        static registry_t *r = new registry_t;
+        return *r;
+    }
+};
+
+inline void report_channel_stats(FILE *fp) { channel_stats_t::report_all(fp); }
+
+#ifdef ENABLE_TRACE
+using default_channel_stats_t = channel_stats_t;
+#else
+using default_channel_stats_t = no_channel_stats_t;
+#endif
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "channel.hpp"
+
+class frame_pool;
+
+// A frame borrowed from a frame_pool, the buffer goes back to the pool when
+// the frame is released or destroyed. Frames are move-only, so two frames
+// never alias the same buffer.
+class pooled_frame
+{
+  public:
+    pooled_frame() : sampled(false), pool(nullptr), idx(-1) {}
+
+    pooled_frame(frame_pool *pool, int idx)
+        : sampled(false), pool(pool), idx(idx)
+    {
+    }
+
+    pooled_frame(pooled_frame &&f)
+        : sampled(f.sampled), pool(f.pool), idx(f.idx)
+    {
+        f.pool = nullptr;
+        f.idx = -1;
+    }
+
+    pooled_frame &operator=(pooled_frame &&f)
+    {
+        if (this != &f) {
+            release();
+            sampled = f.sampled;
+            std::swap(pool, f.pool);
+            std::swap(idx, f.idx);
+        }
+        return *this;
+    }
+
+    pooled_frame(const pooled_frame &) = delete;
+    pooled_frame &operator=(const pooled_frame &) = delete;
+
+    ~pooled_frame() { release(); }
+
+    bool empty() const { return pool == nullptr; }
+
+    // An HWC image header over the pooled buffer.
+    inline cv::Mat &mat() const;
+
+    inline void release();
+
+    // If the producer traces this frame, so that its consumers trace the
+    // same frames, see TRACE_SAMPLED.
+    bool sampled;
+
+  private:
+    frame_pool *pool;
+    int idx;
+};
+
+// A fixed number of 64-byte aligned HWC uint8 buffers.
+// A buffer is allocated by the first acquire() that gets it, not up front,
+// since the frame size is often only known once the first frame is decoded.
+// It is only reallocated if the frame size grows, so the steady state of a
+// capture loop doesn't allocate.
+class frame_pool
+{
+    static constexpr size_t alignment = 64;
+
+  public:
+    explicit frame_pool(int n)
+        : slots(n), free_list(n, overflow_policy::block, "frame_pool")
+    {
+        for (int i = 0; i < n; ++i) { free_list.put(i); }
+    }
+
+    // Blocks until a buffer is free.
+    pooled_frame acquire(int height, int width, int channels = 3)
+    {
+        const int i = free_list.get();
+        slot_t &s = slots[i];
+
+        const size_t size = static_cast<size_t>(height) * width * channels;
+        if (size > s.capacity) {
+            s.raw.reset(new uint8_t[size + alignment - 1]);
+            const uintptr_t p = reinterpret_cast<uintptr_t>(s.raw.get());
+            s.data = reinterpret_cast<uint8_t *>((p + alignment - 1) &
+                                                 ~(alignment - 1));
+            s.capacity = size;
+        }
+        // Reset the header, in case it was reallocated by its previous user.
+        s.mat = cv::Mat(height, width, CV_8UC(channels), s.data);
+
+        return pooled_frame(this, i);
+    }
+
+  private:
+    friend class pooled_frame;
+
+    struct slot_t {
+        std::unique_ptr<uint8_t[]> raw;
+        uint8_t *data = nullptr;
+        size_t capacity = 0;
+        cv::Mat mat;
+    };
+
+    std::vector<slot_t> slots;
+    channel<int> free_list;
+};
+
+cv::Mat &pooled_frame::mat() const { return pool->slots[idx].mat; }
+
+void pooled_frame::release()
+{
+    if (pool) {
+        pool->free_list.put(idx);
+        pool = nullptr;
+        idx = -1;
+    }
+}
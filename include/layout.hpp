@@ -0,0 +1,177 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include <stdtensor>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LAYOUT_HAS_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define LAYOUT_HAS_X86_SIMD 0
+#endif
+
+// Converts an HWC uint8 image into a CHW float tensor in one pass:
+// deinterleave, optionally flip the channel order (RGB <-> BGR) and scale.
+// 3-channel images use an AVX2 or SSE4.1 kernel, chosen at runtime.
+
+inline void hwc_to_chw_scalar(const uint8_t *hwc, int n /* height * width */,
+                              int c, float *chw, float scale, bool flip_rgb)
+{
+    for (int k = 0; k < c; ++k) {
+        const uint8_t *src = hwc + (flip_rgb ? c - 1 - k : k);
+        float *dst = chw + static_cast<size_t>(k) * n;
+        for (int i = 0; i < n; ++i) { dst[i] = src[i * c] * scale; }
+    }
+}
+
+#if LAYOUT_HAS_X86_SIMD
+
+// Splits 16 RGB pixels (48 bytes) into 16 bytes per channel.
+__attribute__((target("sse4.1"))) inline void
+deinterleave_rgb16(const uint8_t *p, __m128i &r, __m128i &g, __m128i &b)
+{
+    const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    const __m128i y =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16));
+    const __m128i z =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 32));
+
+    // x: r0 g0 b0 r1 g1 b1 r2 g2 b2 r3 g3 b3 r4 g4 b4 r5
+    // y: g5 b5 r6 g6 b6 r7 g7 b7 r8 g8 b8 r9 g9 b9 r10 g10
+    // z: b10 r11 g11 b11 r12 g12 b12 r13 g13 b13 r14 g14 b14 r15 g15 b15
+    r = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(x, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1,
+                                                       -1, -1, -1, -1, -1, -1,
+                                                       -1, -1, -1)),
+                     _mm_shuffle_epi8(y, _mm_setr_epi8(-1, -1, -1, -1, -1, -1,
+                                                       2, 5, 8, 11, 14, -1, -1,
+                                                       -1, -1, -1))),
+        _mm_shuffle_epi8(z, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          -1, -1, 1, 4, 7, 10, 13)));
+    g = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(x, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1,
+                                                       -1, -1, -1, -1, -1, -1,
+                                                       -1, -1, -1)),
+                     _mm_shuffle_epi8(y, _mm_setr_epi8(-1, -1, -1, -1, -1, 0,
+                                                       3, 6, 9, 12, 15, -1, -1,
+                                                       -1, -1, -1))),
+        _mm_shuffle_epi8(z, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          -1, -1, 2, 5, 8, 11, 14)));
+    b = _mm_or_si128(
+        _mm_or_si128(_mm_shuffle_epi8(x, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1,
+                                                       -1, -1, -1, -1, -1, -1,
+                                                       -1, -1, -1)),
+                     _mm_shuffle_epi8(y, _mm_setr_epi8(-1, -1, -1, -1, -1, 1,
+                                                       4, 7, 10, 13, -1, -1, -1,
+                                                       -1, -1, -1))),
+        _mm_shuffle_epi8(z, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                          -1, 0, 3, 6, 9, 12, 15)));
+}
+
+__attribute__((target("sse4.1"))) inline void
+store_scaled_sse41(float *dst, __m128i v, __m128 s)
+{
+    _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(v)), s));
+    _mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(
+                                          _mm_srli_si128(v, 4))),
+                                      s));
+    _mm_storeu_ps(dst + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(
+                                          _mm_srli_si128(v, 8))),
+                                      s));
+    _mm_storeu_ps(dst + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(
+                                           _mm_srli_si128(v, 12))),
+                                       s));
+}
+
+__attribute__((target("avx2"))) inline void
+store_scaled_avx2(float *dst, __m128i v, __m256 s)
+{
+    _mm256_storeu_ps(dst,
+                     _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)),
+                                   s));
+    _mm256_storeu_ps(dst + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(
+                                                _mm256_cvtepu8_epi32(
+                                                    _mm_srli_si128(v, 8))),
+                                            s));
+}
+
+__attribute__((target("sse4.1"))) inline void
+hwc_to_chw_rgb_sse41(const uint8_t *hwc, int n, float *chw, float scale,
+                     bool flip_rgb)
+{
+    float *r_dst = chw + (flip_rgb ? 2 * static_cast<size_t>(n) : 0);
+    float *g_dst = chw + n;
+    float *b_dst = chw + (flip_rgb ? 0 : 2 * static_cast<size_t>(n));
+    const __m128 s = _mm_set1_ps(scale);
+
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i r, g, b;
+        deinterleave_rgb16(hwc + 3 * i, r, g, b);
+        store_scaled_sse41(r_dst + i, r, s);
+        store_scaled_sse41(g_dst + i, g, s);
+        store_scaled_sse41(b_dst + i, b, s);
+    }
+    for (; i < n; ++i) {
+        r_dst[i] = hwc[3 * i] * scale;
+        g_dst[i] = hwc[3 * i + 1] * scale;
+        b_dst[i] = hwc[3 * i + 2] * scale;
+    }
+}
+
+__attribute__((target("avx2"))) inline void
+hwc_to_chw_rgb_avx2(const uint8_t *hwc, int n, float *chw, float scale,
+                    bool flip_rgb)
+{
+    float *r_dst = chw + (flip_rgb ? 2 * static_cast<size_t>(n) : 0);
+    float *g_dst = chw + n;
+    float *b_dst = chw + (flip_rgb ? 0 : 2 * static_cast<size_t>(n));
+    const __m256 s = _mm256_set1_ps(scale);
+
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i r, g, b;
+        deinterleave_rgb16(hwc + 3 * i, r, g, b);
+        store_scaled_avx2(r_dst + i, r, s);
+        store_scaled_avx2(g_dst + i, g, s);
+        store_scaled_avx2(b_dst + i, b, s);
+    }
+    for (; i < n; ++i) {
+        r_dst[i] = hwc[3 * i] * scale;
+        g_dst[i] = hwc[3 * i + 1] * scale;
+        b_dst[i] = hwc[3 * i + 2] * scale;
+    }
+}
+
+#endif  // LAYOUT_HAS_X86_SIMD
+
+inline void hwc_to_chw(const uint8_t *hwc, int height, int width, int c,
+                       float *chw, float scale = 1 / 255.0,
+                       bool flip_rgb = false)
+{
+    const int n = height * width;
+#if LAYOUT_HAS_X86_SIMD
+    using kernel_t = void (*)(const uint8_t *, int, float *, float, bool);
+    static const kernel_t rgb_kernel = []() -> kernel_t {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) { return hwc_to_chw_rgb_avx2; }
+        if (__builtin_cpu_supports("sse4.1")) { return hwc_to_chw_rgb_sse41; }
+        return nullptr;
+    }();
+    if (c == 3 && rgb_kernel) {
+        rgb_kernel(hwc, n, chw, scale, flip_rgb);
+        return;
+    }
+#endif
+    hwc_to_chw_scalar(hwc, n, c, chw, scale, flip_rgb);
+}
+
+inline void hwc_to_chw(const ttl::tensor_view<uint8_t, 3> &hwc,
+                       ttl::tensor_ref<float, 3> chw,
+                       float scale = 1 / 255.0, bool flip_rgb = false)
+{
+    const auto dims = hwc.shape().dims;
+    hwc_to_chw(hwc.data(), dims[0], dims[1], dims[2], chw.data(),
+               scale, flip_rgb);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <vector>
+
+#include <stdtensor>
+
+#include <openpose-plus.hpp>
+
+/*! Batched feature maps kept in float16 on the host.
+    heatmap :: batch_size * n_joins * H' * W'
+    PAF map :: batch_size * (2 * n_connections) * H' * W'
+    Only one image at a time is expanded to float for the paf_processor, so
+    host memory for a batch is about half of the float32 layout.
+*/
+class half_feature_maps_t
+{
+  public:
+    half_feature_maps_t(int batch_size, int n_joins, int n_connections,
+                        int height, int width)
+        : heatmap(batch_size, n_joins, height, width),
+          paf(batch_size, 2 * n_connections, height, width),
+          heatmap_f32(n_joins, height, width),
+          paf_f32(2 * n_connections, height, width)
+    {
+    }
+
+    //! Stores the float outputs of a runner for the first n images.
+    void store(const float *heatmap_ptr, const float *paf_ptr, int n)
+    {
+        ttl::float_to_half(heatmap_ptr, heatmap.data(),
+                           n * heatmap_f32.shape().size());
+        ttl::float_to_half(paf_ptr, paf.data(), n * paf_f32.shape().size());
+    }
+
+    //! Runs the paf_processor on the i-th image.
+    std::vector<human_t> operator()(paf_processor &process, int i,
+                                    bool use_gpu)
+    {
+        ttl::cast(ttl::tensor_view<ttl::half, 3>(heatmap[i]),
+                  ttl::tensor_ref<float, 3>(heatmap_f32));
+        ttl::cast(ttl::tensor_view<ttl::half, 3>(paf[i]),
+                  ttl::tensor_ref<float, 3>(paf_f32));
+        return process(heatmap_f32.data(), paf_f32.data(), use_gpu);
+    }
+
+    ttl::tensor<ttl::half, 4> heatmap;
+    ttl::tensor<ttl::half, 4> paf;
+
+  private:
+    ttl::tensor<float, 3> heatmap_f32;
+    ttl::tensor<float, 3> paf_f32;
+};
@@ -0,0 +1,133 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*! A per-frame bump allocator for post-processing temporaries.
+    Memory is handed out linearly and only given back all at once by reset(),
+    which is meant to be called once per frame. If a frame needs more than
+    the current capacity, the extra chunks are merged into one on reset(), so
+    after a few frames the workspace stops touching the heap.
+*/
+class workspace_t
+{
+  public:
+    explicit workspace_t(size_t capacity = 1 << 20)
+        : offset(0), heap_allocations_(0), high_water_(0), used_(0)
+    {
+        add_chunk(capacity);
+    }
+
+    workspace_t(const workspace_t &) = delete;
+    workspace_t &operator=(const workspace_t &) = delete;
+
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        chunk_t *c = &chunks.back();
+        size_t p = aligned_offset(*c, offset, alignment);
+        if (p + size > c->size) {
+            add_chunk(std::max(c->size * 2, size + alignment));
+            c = &chunks.back();
+            p = aligned_offset(*c, 0, alignment);
+        }
+        offset = p + size;
+        used_ += size;
+        return c->data.get() + p;
+    }
+
+    // Everything is released by reset().
+    void deallocate(void * /* p */, size_t /* size */) {}
+
+    void reset()
+    {
+        high_water_ = std::max(high_water_, used_);
+        if (chunks.size() > 1) {
+            size_t total = 0;
+            for (const auto &c : chunks) { total += c.size; }
+            chunks.clear();
+            add_chunk(total);
+        }
+        offset = 0;
+        used_ = 0;
+    }
+
+    //! Number of times the workspace allocated from the heap, it stays
+    //! constant once the workspace has grown to the per-frame peak.
+    size_t heap_allocations() const { return heap_allocations_; }
+
+    //! Maximum number of bytes used by one frame.
+    size_t high_water() const { return std::max(high_water_, used_); }
+
+  private:
+    struct chunk_t {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size;
+    };
+
+    std::vector<chunk_t> chunks;
+    size_t offset;  // in chunks.back()
+
+    size_t heap_allocations_;
+    size_t high_water_;
+    size_t used_;
+
+    static size_t aligned_offset(const chunk_t &c, size_t off,
+                                 size_t alignment)
+    {
+        const uintptr_t base = reinterpret_cast<uintptr_t>(c.data.get());
+        const uintptr_t p = (base + off + alignment - 1) / alignment * alignment;
+        return p - base;
+    }
+
+    void add_chunk(size_t size)
+    {
+        // clear() keeps the capacity, so this stops after the first frames
+        if (chunks.size() == chunks.capacity()) { ++heap_allocations_; }
+        chunks.push_back(chunk_t{std::unique_ptr<uint8_t[]>(new uint8_t[size]),
+                                 size});
+        offset = 0;
+        ++heap_allocations_;
+    }
+};
+
+//! A std-compatible allocator over a workspace_t.
+template <typename T> struct workspace_allocator {
+    using value_type = T;
+
+    workspace_t *ws;
+
+    explicit workspace_allocator(workspace_t &ws) : ws(&ws) {}
+
+    template <typename S>
+    workspace_allocator(const workspace_allocator<S> &a) : ws(a.ws)
+    {
+    }
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(ws->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, size_t n) { ws->deallocate(p, n * sizeof(T)); }
+};
+
+template <typename T, typename S>
+bool operator==(const workspace_allocator<T> &a,
+                const workspace_allocator<S> &b)
+{
+    return a.ws == b.ws;
+}
+
+template <typename T, typename S>
+bool operator!=(const workspace_allocator<T> &a,
+                const workspace_allocator<S> &b)
+{
+    return a.ws != b.ws;
+}
+
+// Growing a vector leaves its old buffer in the workspace until reset(),
+// so reserve() the expected size up front.
+template <typename T>
+using workspace_vector = std::vector<T, workspace_allocator<T>>;
@@ -0,0 +1,194 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A single-producer/single-consumer variant of channel<T>.
+// Elements are stored in a preallocated power-of-two ring, put/get only
+// touch the lock when the other side has to be parked or woken up.
+template <typename T> class spsc_channel
+{
+    static constexpr size_t cache_line_size = 64;
+    static constexpr int spin_count = 128;
+
+    using clock_t = std::chrono::steady_clock;
+
+  public:
+    spsc_channel(int cap)
+        : cap(cap), mask(round_up_pow2(cap) - 1), buffer(mask + 1), head(0),
+          tail(0), cached_head(0), cached_tail(0), closed(false), waiters(0)
+    {
+    }
+
+    // Blocks until an item is available, returns T() if the channel is
+    // closed and drained.
+    T get()
+    {
+        T x = T();
+        if (readable()) {
+            take(x);
+        } else {
+            wait_until([&]() { return readable() || is_closed(); });
+            if (readable()) { take(x); }
+        }
+        return x;
+    }
+
+    bool try_get(T &x)
+    {
+        if (!readable()) { return false; }
+        take(x);
+        return true;
+    }
+
+    // Returns false on timeout or if the channel is closed and drained.
+    template <typename Rep, typename Period>
+    bool get_for(T &x, const std::chrono::duration<Rep, Period> &timeout)
+    {
+        if (!readable()) {
+            wait_until([&]() { return readable() || is_closed(); },
+                       clock_t::now() + timeout);
+            if (!readable()) { return false; }
+        }
+        take(x);
+        return true;
+    }
+
+    // Returns false if the channel is closed.
+    bool put(T x)
+    {
+        if (!writable()) {
+            wait_until([&]() { return writable() || is_closed(); });
+        }
+        return push(std::move(x));
+    }
+
+    // Returns false on timeout or if the channel is closed.
+    template <typename Rep, typename Period>
+    bool put_for(T x, const std::chrono::duration<Rep, Period> &timeout)
+    {
+        if (!writable()) {
+            wait_until([&]() { return writable() || is_closed(); },
+                       clock_t::now() + timeout);
+            if (!writable()) { return false; }
+        }
+        return push(std::move(x));
+    }
+
+    void close()
+    {
+        closed.store(true, std::memory_order_seq_cst);
+        { std::lock_guard<std::mutex> _(mu); }
+        cv.notify_all();
+    }
+
+    // true if the channel is closed and all items have been consumed
+    bool drained()
+    {
+        return is_closed() && head.load(std::memory_order_seq_cst) ==
+                                  tail.load(std::memory_order_seq_cst);
+    }
+
+  private:
+    const size_t cap;
+    const size_t mask;
+
+    std::vector<T> buffer;
+
+    // head is only written by the consumer, tail only by the producer.
+    alignas(cache_line_size) std::atomic<size_t> head;
+    alignas(cache_line_size) std::atomic<size_t> tail;
+
+    // local copies of the index owned by the other side
+    alignas(cache_line_size) size_t cached_head;  // producer only
+    alignas(cache_line_size) size_t cached_tail;  // consumer only
+
+    alignas(cache_line_size) std::atomic<bool> closed;
+    std::atomic<int> waiters;
+    std::mutex mu;
+    std::condition_variable cv;
+
+    static size_t round_up_pow2(int n)
+    {
+        size_t m = 1;
+        while (m < static_cast<size_t>(n)) { m <<= 1; }
+        return m;
+    }
+
+    bool is_closed() const { return closed.load(std::memory_order_seq_cst); }
+
+    // called by the consumer
+    bool readable()
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (cached_tail != h) { return true; }
+        cached_tail = tail.load(std::memory_order_seq_cst);
+        return cached_tail != h;
+    }
+
+    // called by the producer
+    bool writable()
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cached_head < cap) { return true; }
+        cached_head = head.load(std::memory_order_seq_cst);
+        return t - cached_head < cap;
+    }
+
+    void take(T &x)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        x = std::move(buffer[h & mask]);
+        head.store(h + 1, std::memory_order_seq_cst);
+        wake_up();
+    }
+
+    bool push(T x)
+    {
+        if (is_closed()) { return false; }
+        const size_t t = tail.load(std::memory_order_relaxed);
+        buffer[t & mask] = std::move(x);
+        tail.store(t + 1, std::memory_order_seq_cst);
+        wake_up();
+        return true;
+    }
+
+    template <typename P> void wait_until(const P &ready)
+    {
+        for (int i = 0; i < spin_count; ++i) {
+            if (ready()) { return; }
+            std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lk(mu);
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        cv.wait(lk, ready);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    template <typename P>
+    void wait_until(const P &ready, const clock_t::time_point &deadline)
+    {
+        for (int i = 0; i < spin_count; ++i) {
+            if (ready() || clock_t::now() >= deadline) { return; }
+            std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lk(mu);
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        cv.wait_until(lk, deadline, ready);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void wake_up()
+    {
+        if (waiters.load(std::memory_order_seq_cst) > 0) {
+            { std::lock_guard<std::mutex> _(mu); }
+            cv.notify_one();
+        }
+    }
+};
@@ -0,0 +1,78 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "channel.hpp"
+#include "spsc_channel.hpp"
+
+// Passes n items from one producer thread to one consumer thread.
+template <typename channel_t> void bench(const char *name, int cap, int n)
+{
+    using clock_t = std::chrono::system_clock;
+    using duration_t = std::chrono::duration<double>;
+
+    channel_t ch(cap);
+    long sum = 0;
+
+    const auto t0 = clock_t::now();
+    std::thread producer([&]() {
+        for (int i = 0; i < n; ++i) { ch.put(i); }
+    });
+    std::thread consumer([&]() {
+        for (int i = 0; i < n; ++i) { sum += ch.get(); }
+    });
+    producer.join();
+    consumer.join();
+    const duration_t d = clock_t::now() - t0;
+
+    printf("// %-16s cap: %4d, %d items took %.3fs, %.2fns per item, "
+           "check sum: %ld\n",
+           name, cap, n, d.count(), d.count() * 1e9 / n, sum);
+}
+
+// Passes n items from m producer threads to one consumer thread, which drains
+// up to batch_size items at a time.
+void bench_fan_in(int m, int cap, int batch_size, int n)
+{
+    using clock_t = std::chrono::system_clock;
+    using duration_t = std::chrono::duration<double>;
+
+    channel<int> ch(cap);
+    long sum = 0;
+
+    const auto t0 = clock_t::now();
+    std::vector<std::thread> producers;
+    for (int j = 0; j < m; ++j) {
+        producers.push_back(std::thread([&, j]() {
+            for (int i = j; i < n; i += m) { ch.put(i); }
+        }));
+    }
+    std::thread consumer([&]() {
+        std::vector<int> batch;
+        for (int i = 0; i < n;) {
+            batch.clear();
+            i += ch.get_batch(batch, batch_size);
+            for (int x : batch) { sum += x; }
+        }
+    });
+    for (auto &th : producers) { th.join(); }
+    consumer.join();
+    const duration_t d = clock_t::now() - t0;
+
+    printf("// fan-in %2d -> 1   cap: %4d, batch size: %2d, %d items took "
+           "%.3fs, %.2fns per item, check sum: %ld\n",
+           m, cap, batch_size, n, d.count(), d.count() * 1e9 / n, sum);
+}
+
+int main(int argc, char *argv[])
+{
+    const int n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    for (int cap : {1, 24, 1024}) {
+        bench<channel<int>>("channel", cap, n);
+        bench<spsc_channel<int>>("spsc_channel", cap, n);
+    }
+    for (int batch_size : {1, 8}) { bench_fan_in(4, 24, batch_size, n); }
+    return 0;
+}
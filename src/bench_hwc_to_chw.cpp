@@ -0,0 +1,69 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include <stdtensor>
+
+#include "layout.hpp"
+
+using ttl::tensor_ref;
+
+// the per-pixel loop used by the inputer of demo_live_camera
+void hwc_to_chw_at(int height, int width, uint8_t *hwc_ptr, float *chw_ptr)
+{
+    tensor_ref<uint8_t, 3> s(hwc_ptr, height, width, 3);
+    tensor_ref<float, 3> t(chw_ptr, 3, height, width);
+    for (int k = 0; k < 3; ++k) {
+        for (int i = 0; i < height; ++i) {
+            for (int j = 0; j < width; ++j) {
+                t.at(k, i, j) = s.at(i, j, k) / 255.0;
+            }
+        }
+    }
+}
+
+template <typename F>
+void bench(const char *name, int repeat, const std::vector<float> &expect,
+           std::vector<float> &chw, const F &f)
+{
+    using clock_t = std::chrono::system_clock;
+    using duration_t = std::chrono::duration<double>;
+
+    const auto t0 = clock_t::now();
+    for (int i = 0; i < repeat; ++i) { f(); }
+    const duration_t d = clock_t::now() - t0;
+
+    float max_err = 0;
+    for (size_t i = 0; i < chw.size(); ++i) {
+        max_err = std::max(max_err, std::fabs(chw[i] - expect[i]));
+    }
+    printf("// %-24s %d times took %.3fs, mean: %.4fms, max error: %g\n", name,
+           repeat, d.count(), d.count() * 1000 / repeat, max_err);
+}
+
+int main(int argc, char *argv[])
+{
+    const int height = 368;
+    const int width = 432;
+    const int repeat = argc > 1 ? std::atoi(argv[1]) : 100;
+
+    std::vector<uint8_t> hwc(height * width * 3);
+    for (auto &x : hwc) { x = std::rand() % 256; }
+    std::vector<float> expect(hwc.size());
+    std::vector<float> chw(hwc.size());
+    hwc_to_chw_at(height, width, hwc.data(), expect.data());
+
+    bench("tensor_ref::at", repeat, expect, chw,
+          [&]() { hwc_to_chw_at(height, width, hwc.data(), chw.data()); });
+    bench("hwc_to_chw_scalar", repeat, expect, chw, [&]() {
+        hwc_to_chw_scalar(hwc.data(), height * width, 3, chw.data(),
+                          1 / 255.0, false);
+    });
+    bench("hwc_to_chw", repeat, expect, chw, [&]() {
+        hwc_to_chw(hwc.data(), height, width, 3, chw.data(), 1 / 255.0,
+                   false);
+    });
+    return 0;
+}
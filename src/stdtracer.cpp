@@ -0,0 +1,23 @@
+// The default trace contexts declared by <stdtracer>, for the mode selected
+// by the STD_TRACER_* macros.
+#include <stdtracer>
+
+#if STD_TRACER_USE_STACK_TRACER
+stack_tracer_ctx_t default_stack_tracer_ctx("global");
+#elif STD_TRACER_USE_CHROME_TRACER
+chrome_tracer_ctx_t default_chrome_tracer_ctx("global");
+#elif STD_TRACER_USE_FAST_TRACER
+fast_tracer_ctx_t default_fast_tracer_ctx("global");
+#elif STD_TRACER_USE_PERF_TRACER
+perf_tracer_ctx_t default_perf_tracer_ctx("global");
+#else
+simple_tracer_ctx_t default_simple_ctx("global");
+#ifdef STD_TRACER_ASYNC_LOG
+async_log_tracer_ctx_t default_async_log_ctx("global");
+#else
+log_tracer_ctx_t default_log_ctx("global");
+#endif
+#ifdef STD_TRACER_COUNT_ALLOCS
+alloc_tracer_ctx_t default_alloc_tracer_ctx("global", default_simple_ctx);
+#endif
+#endif
@@ -0,0 +1,57 @@
+// Checks that get_batch_for flushes partial batches without waiting out
+// the timeout when the producer is blocked on a full channel.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "channel.hpp"
+
+int check_batch_larger_than_cap()
+{
+    const int n = 20;
+    channel<int> ch(2);
+    std::thread producer([&] {
+        for (int i = 0; i < n; ++i) { ch.put(i); }
+        ch.close();
+    });
+
+    const auto t0 = std::chrono::steady_clock::now();
+    std::vector<int> out;
+    while (ch.get_batch_for(out, 4, std::chrono::milliseconds(100)) > 0) {}
+    const std::chrono::duration<double> d =
+        std::chrono::steady_clock::now() - t0;
+    producer.join();
+
+    // each stalled call would wait out the full 100ms
+    if (out.size() != n || d.count() > 0.5) {
+        fprintf(stderr, "max_n > cap: got %d items in %.3fs\n",
+                (int)out.size(), d.count());
+        return 1;
+    }
+    return 0;
+}
+
+int check_partial_batch_on_deadline()
+{
+    channel<int> ch(8);
+    ch.put(1);
+    std::vector<int> out;
+    const int n = ch.get_batch_for(out, 4, std::chrono::milliseconds(10));
+    if (n != 1) {
+        fprintf(stderr, "partial batch: got %d items, expected 1\n", n);
+        return 1;
+    }
+    return 0;
+}
+
+int main()
+{
+    int failed = 0;
+    failed += check_batch_larger_than_cap();
+    failed += check_partial_batch_on_deadline();
+    if (failed) { return EXIT_FAILURE; }
+    printf("// OK\n");
+    return EXIT_SUCCESS;
+}
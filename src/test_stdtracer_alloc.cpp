@@ -0,0 +1,87 @@
+// Checks that alloc_tracer_ctx_t_ counts the allocations of the traced code,
+// and none of the tracer's own.
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <stdtracer.hpp>
+#include <stdtracer_alloc_hooks>
+
+simple_tracer_ctx_t default_simple_ctx("global");
+alloc_tracer_ctx_t default_alloc_tracer_ctx("global", default_simple_ctx);
+
+// TRACE_SCOPE of <stdtracer_simple> with STD_TRACER_COUNT_ALLOCS, without
+// the log context, which would print every scope
+using tracer_t = switched_scope_t<multi_ctx_scope_t_<
+    default_clock_t, simple_tracer_ctx_t, alloc_tracer_ctx_t>>;
+
+#define TRACE_SCOPE(name)                                                      \
+    tracer_t _((name), default_simple_ctx, default_alloc_tracer_ctx)
+
+void inner_without_allocation()
+{
+    TRACE_SCOPE("inner::a_long_scope_name_without_allocation");
+}
+
+void inner_with_allocation()
+{
+    TRACE_SCOPE("inner::a_long_scope_name_with_one_allocation");
+    std::unique_ptr<char[]> p(new char[100]);
+}
+
+const std::string call_name("inner::a_scope_named_by_a_std_string");
+
+void frame()
+{
+    TRACE_SCOPE("outer::frame");
+    inner_without_allocation();
+    inner_without_allocation();
+    inner_with_allocation();
+    {
+        TRACE_SCOPE(call_name);  // by std::string
+        inner_without_allocation();
+    }
+}
+
+int check(const std::string &name, uint64_t self_allocs, uint64_t allocs,
+          uint64_t bytes)
+{
+    for (const auto &s : default_alloc_tracer_ctx.summaries()) {
+        if (s.name != name) { continue; }
+        if (s.self_allocs == self_allocs * s.count &&
+            s.allocs == allocs * s.count && s.bytes == bytes * s.count) {
+            return 0;
+        }
+        fprintf(stderr,
+                "%s: %lu calls, %lu self allocs, %lu allocs, %lu bytes, "
+                "expected %lu, %lu, %lu per call\n",
+                name.c_str(), (unsigned long)s.count,
+                (unsigned long)s.self_allocs, (unsigned long)s.allocs,
+                (unsigned long)s.bytes, (unsigned long)self_allocs,
+                (unsigned long)allocs, (unsigned long)bytes);
+        return 1;
+    }
+    fprintf(stderr, "%s: not traced\n", name.c_str());
+    return 1;
+}
+
+int main()
+{
+    default_trace_switch().set_mode(trace_switch_t::on);
+    for (int i = 0; i < 10; ++i) { frame(); }
+    std::thread th([] {
+        for (int i = 0; i < 10; ++i) { frame(); }
+    });
+    th.join();
+
+    int failed = 0;
+    failed += check("outer::frame", 0, 1, 100);
+    failed += check("inner::a_long_scope_name_without_allocation", 0, 0, 0);
+    failed += check("inner::a_long_scope_name_with_one_allocation", 1, 1, 100);
+    failed += check(call_name, 0, 0, 0);
+    if (failed) { return EXIT_FAILURE; }
+    printf("// OK\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,35 @@
+// Checks that workspace_t stops touching the heap once it has grown to the
+// per-frame peak.
+#include <cstdio>
+#include <cstdlib>
+
+#include "openpose-plus/workspace.h"
+
+// temporaries of a frame, more than the initial capacity in several pieces
+void frame(workspace_t &ws)
+{
+    workspace_allocator<float> a(ws);
+    for (int k = 0; k < 8; ++k) {
+        workspace_vector<float> v(a);
+        v.reserve(1000 + 100 * k);
+        for (int i = 0; i < 1000; ++i) { v.push_back(i); }
+        workspace_vector<int> w(a);
+        for (int i = 0; i < 100; ++i) { w.push_back(i); }  // grows
+    }
+    ws.reset();
+}
+
+int main()
+{
+    workspace_t ws(1 << 10);
+    for (int i = 0; i < 3; ++i) { frame(ws); }  // warm up
+    const size_t n = ws.heap_allocations();
+    for (int i = 0; i < 10; ++i) { frame(ws); }
+    if (ws.heap_allocations() != n) {
+        fprintf(stderr, "%lu heap allocations after warm-up\n",
+                (unsigned long)(ws.heap_allocations() - n));
+        return EXIT_FAILURE;
+    }
+    printf("// OK\n");
+    return EXIT_SUCCESS;
+}